@@ -1,9 +1,6 @@
 //? #version 450
 
-uniform sampler2D ColorTexture;
 uniform sampler2D DepthTexture;
-uniform sampler2D NormalTexture;
-uniform sampler2D SpecularShininessTexture;
 uniform mat4 InverseProjection;
 uniform vec2 ScreenSize;
 
@@ -14,35 +11,44 @@ struct GBufferData
 	ivec2 fragCoord;
 };
 
-GBufferData readFromGbuffer()
+// The targets and the way they are packed depend on the layout
+#include "gbufferEncoding.glsl"
+#include "gbufferLayout.glsl"
+
+// Reads the G-buffer at any pixel, including the background, where ssDepth is 1
+GBufferData readGbufferAt(ivec2 fragCoord)
 {
 	GBufferData result;
 
 	// Get all the required values
-	ivec2 fragCoord = ivec2(gl_FragCoord.xy);
-	
-	vec4 colorData = texelFetch(ColorTexture, fragCoord, 0);
 	float depthData = texelFetch(DepthTexture, fragCoord, 0).r;
-	vec2 normalData = texelFetch(NormalTexture, fragCoord, 0).rg;
-	vec2 specShinyData = texelFetch(SpecularShininessTexture, fragCoord, 0).rg;
-
-	// Discard if depth data is still the same
-	if (depthData == 1.0) discard;
-
-	// Reconstruct the data
-	result.color = colorData.rgb;
-	result.normal = vec3(normalData, sqrt(1.0 - dot(normalData, normalData)));
-	if (colorData.a == 1.0) result.normal.z = -result.normal.z;
+	readGbufferAttributes(fragCoord, result);
 
 	// Reconstruct the position
-	vec3 deviceCoords = 2.0 * vec3(gl_FragCoord.xy / ScreenSize, depthData) - 1.0;
+	vec3 deviceCoords = 2.0 * vec3((vec2(fragCoord) + 0.5) / ScreenSize, depthData) - 1.0;
 	vec4 homogeneousPos = InverseProjection * vec4(deviceCoords, 1.0);
 	result.position = homogeneousPos.xyz / homogeneousPos.w;
 
 	result.ssDepth = depthData;
 	result.fragCoord = fragCoord;
-	result.specular = specShinyData.r;
-	result.shininess = specShinyData.g;
 
 	return result;
-}
\ No newline at end of file
+}
+
+// Compute shaders cannot discard, nor do they have a fragment coordinate
+#ifndef COMPUTE_SHADER
+// Reads the G-buffer at another pixel than the one being shaded
+GBufferData readFromGbuffer(ivec2 fragCoord)
+{
+	GBufferData result = readGbufferAt(fragCoord);
+
+	// Discard if depth data is still the same
+	if (result.ssDepth == 1.0) discard;
+	return result;
+}
+
+GBufferData readFromGbuffer()
+{
+	return readFromGbuffer(ivec2(gl_FragCoord.xy));
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+//? #version 450
+
+// The encodings used by the G-buffer layouts in GBufferLayout.cpp
+
+// The normal is stored as its xy components, with 1 in z when its z is negative
+vec3 encodeNormalSign(vec3 normal)
+{
+	return vec3(normal.xy, normal.z < 0);
+}
+
+vec3 decodeNormalSign(vec3 data)
+{
+	vec3 normal = vec3(data.xy, sqrt(1.0 - dot(data.xy, data.xy)));
+	if (data.z == 1.0) normal.z = -normal.z;
+	return normal;
+}
+
+vec2 signNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Projects the normal onto an octahedron, then unfolds it into a square. Each coordinate
+// gets 12 bits, spread over three 8-bit channels
+vec3 encodeNormalOctahedral(vec3 normal)
+{
+	normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+	vec2 octahedral = normal.z >= 0.0 ? normal.xy : (1.0 - abs(normal.yx)) * signNotZero(normal.xy);
+
+	uvec2 bits = uvec2(round((octahedral * 0.5 + 0.5) * 4095.0));
+	return vec3(bits.x >> 4, ((bits.x & 15u) << 4) | (bits.y >> 8), bits.y & 255u) / 255.0;
+}
+
+vec3 decodeNormalOctahedral(vec3 data)
+{
+	uvec3 bytes = uvec3(round(data * 255.0));
+	uvec2 bits = uvec2((bytes.x << 4) | (bytes.y >> 4), ((bytes.y & 15u) << 8) | bytes.z);
+	vec2 octahedral = vec2(bits) / 4095.0 * 2.0 - 1.0;
+
+	vec3 normal = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+	if (normal.z < 0.0) normal.xy = (1.0 - abs(normal.yx)) * signNotZero(normal.xy);
+	return normalize(normal);
+}
+
+// The shininess is an exponent, so its precision matters relative to its value
+const float MaxEncodedShininess = 1023.0;
+
+float encodeShininess(float shininess)
+{
+	return log2(1.0 + shininess) / log2(1.0 + MaxEncodedShininess);
+}
+
+float decodeShininess(float data)
+{
+	return exp2(data * log2(1.0 + MaxEncodedShininess)) - 1.0;
+}
@@ -0,0 +1,40 @@
+#version 450
+
+// Only the source level is made visible through the base level of the texture,
+// so it can be read while the next level is being written
+uniform sampler2D SourceTexture;
+uniform bool Downsample;
+
+out float minDepth;
+
+float fetchDepth(ivec2 coord, ivec2 sourceSize)
+{
+	return texelFetch(SourceTexture, min(coord, sourceSize - 1), 0).r;
+}
+
+void main()
+{
+	ivec2 fragCoord = ivec2(gl_FragCoord.xy);
+
+	// The first level is a plain copy of the depth buffer
+	if (!Downsample)
+	{
+		minDepth = texelFetch(SourceTexture, fragCoord, 0).r;
+		return;
+	}
+
+	ivec2 sourceSize = textureSize(SourceTexture, 0);
+	ivec2 size = max(sourceSize / 2, ivec2(1));
+	ivec2 source = 2 * fragCoord;
+
+	minDepth = min(min(fetchDepth(source, sourceSize), fetchDepth(source + ivec2(1, 0), sourceSize)),
+		min(fetchDepth(source + ivec2(0, 1), sourceSize), fetchDepth(source + ivec2(1, 1), sourceSize)));
+
+	// On odd sizes, the last row and column also cover the texels left out by the halving
+	bool extraX = (sourceSize.x & 1) != 0 && fragCoord.x == size.x - 1;
+	bool extraY = (sourceSize.y & 1) != 0 && fragCoord.y == size.y - 1;
+
+	if (extraX) minDepth = min(minDepth, min(fetchDepth(source + ivec2(2, 0), sourceSize), fetchDepth(source + ivec2(2, 1), sourceSize)));
+	if (extraY) minDepth = min(minDepth, min(fetchDepth(source + ivec2(0, 2), sourceSize), fetchDepth(source + ivec2(1, 2), sourceSize)));
+	if (extraX && extraY) minDepth = min(minDepth, fetchDepth(source + ivec2(2, 2), sourceSize));
+}
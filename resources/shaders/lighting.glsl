@@ -8,16 +8,31 @@ struct DirectionalLight
 
 uniform DirectionalLight Light;
 
-uniform sampler2DShadow ShadowMapTexture;
+// Must match the constant in Lighting.hpp
+const int NumShadowCascades = 4;
 
-float computeLightFactor(vec4 positionLight, vec3 normal)
+uniform sampler2DArrayShadow ShadowMapTexture;
+uniform mat4 ShadowViewProjections[NumShadowCascades]; // From view space
+uniform float ShadowCascadeSplits[NumShadowCascades];
+uniform float ShadowTexelSizes[NumShadowCascades];
+
+float computeLightFactor(vec3 position, vec3 normal)
 {
+	// Pick the first cascade which reaches this far, everything past the last one is lit
+	int cascade = 0;
+	while (cascade < NumShadowCascades && -position.z > ShadowCascadeSplits[cascade]) cascade++;
+	if (cascade == NumShadowCascades) return 1.0;
+
+	// The texels get larger with each cascade, so offset the position along the normal by a texel as well
+	vec3 norm = normalize(normal);
+	vec4 positionLight = ShadowViewProjections[cascade] * vec4(position + norm * ShadowTexelSizes[cascade], 1.0);
+
 	vec3 projectedTexcoord = positionLight.xyz / positionLight.w * 0.5 + 0.5;
-	projectedTexcoord.z -= max(0.0025 * (1.0 - dot(normalize(normal), -Light.directionView)), 0.00025);
-	return texture(ShadowMapTexture, projectedTexcoord);
+	projectedTexcoord.z -= max(0.0025 * (1.0 - dot(norm, -Light.directionView)), 0.00025);
+	return texture(ShadowMapTexture, vec4(projectedTexcoord.xy, cascade, projectedTexcoord.z));
 }
 
-vec3 computeLighting(vec3 ambient, vec3 diffuse, vec3 specular, float shininess, vec3 position, vec3 normal, vec4 positionLight)
+vec3 computeLighting(vec3 ambient, vec3 diffuse, vec3 specular, float shininess, vec3 position, vec3 normal)
 {
 	// get the ambient contribution
 	ambient = Light.ambient * ambient;
@@ -35,6 +50,6 @@ vec3 computeLighting(vec3 ambient, vec3 diffuse, vec3 specular, float shininess,
 	specular = Light.specular * (specf * specular);
 
 	// Shadow (add some bias)
-	float light = computeLightFactor(positionLight, normal);
+	float light = computeLightFactor(position, normal);
 	return ambient + light * (diffuse + specular);
 }
\ No newline at end of file
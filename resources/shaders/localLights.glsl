@@ -0,0 +1,62 @@
+//? #version 450
+
+// Needs gbuffer.glsl to be included first
+
+struct LocalLight
+{
+	vec4 positionRadius;    // View space position and radius of influence
+	vec4 colorCosOuter;     // Color and cosine of the outer cone angle
+	vec4 directionCosInner; // View space direction and cosine of the inner cone angle
+};
+
+layout(std430, binding = 0) readonly buffer LightBuffer { LocalLight lights[]; };
+
+vec3 computeLocalLight(LocalLight light, GBufferData data, vec3 specularColor)
+{
+	vec3 toLight = light.positionRadius.xyz - data.position;
+	float dist = length(toLight);
+	if (dist >= light.positionRadius.w) return vec3(0.0);
+	vec3 lightDirection = toLight / dist;
+
+	// Inverse square falloff, windowed to reach zero at the radius
+	float window = clamp(1.0 - pow(dist / light.positionRadius.w, 4.0), 0.0, 1.0);
+	float attenuation = window * window / (1.0 + dist * dist);
+	attenuation *= smoothstep(light.colorCosOuter.w, light.directionCosInner.w, dot(-lightDirection, light.directionCosInner.xyz));
+
+	// Same model as the directional light
+	vec3 norm = normalize(data.normal);
+	float cosd = max(dot(norm, lightDirection), 0.0);
+
+	vec3 halfwayDir = normalize(lightDirection + normalize(-data.position));
+	float energyCons = (8.0 + data.shininess) / 25.1327412287;
+	float specf = energyCons * pow(max(dot(halfwayDir, norm), 0.0), data.shininess);
+
+	return light.colorCosOuter.rgb * attenuation * (cosd * data.color + specf * specularColor);
+}
+
+#ifdef CLUSTERED_LIGHTS
+// All must match the constants in LightClusters.hpp
+const ivec3 ClusterGrid = ivec3(32, 18, 24);
+
+// The offset and count of the lights of each cluster in the index list
+layout(std430, binding = 2) readonly buffer ClusterBuffer { uvec2 clusterRanges[]; };
+layout(std430, binding = 3) readonly buffer ClusterIndexBuffer { uint clusterLights[]; };
+
+uniform bool UseClusteredLights;
+uniform float ClusterSliceScale, ClusterSliceBias;
+
+vec3 computeClusteredLights(GBufferData data, vec3 specularColor)
+{
+	if (!UseClusteredLights) return vec3(0.0);
+
+	// The slices are exponential in the view space depth
+	ivec2 tile = min(ivec2(vec2(data.fragCoord) * vec2(ClusterGrid.xy) / ScreenSize), ClusterGrid.xy - 1);
+	int slice = clamp(int(log(-data.position.z) * ClusterSliceScale + ClusterSliceBias), 0, ClusterGrid.z - 1);
+	uvec2 range = clusterRanges[(slice * ClusterGrid.y + tile.y) * ClusterGrid.x + tile.x];
+
+	vec3 color = vec3(0.0);
+	for (uint i = range.x; i < range.x + range.y; i++)
+		color += computeLocalLight(lights[clusterLights[i]], data, specularColor);
+	return color;
+}
+#endif
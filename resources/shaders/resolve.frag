@@ -1,6 +1,8 @@
 #version 450
 
+#define CLUSTERED_LIGHTS
 #include "gbuffer.glsl"
+#include "localLights.glsl"
 #include "lighting.glsl"
 
 struct MaterialDefinition
@@ -10,16 +12,14 @@ struct MaterialDefinition
 
 uniform MaterialDefinition Material;
 
-uniform mat4 InvViewShadowViewProjection;
-
 out vec4 fragColor;
 
 void main()
 {
 	GBufferData data = readFromGbuffer();
-	vec4 positionLight = InvViewShadowViewProjection * vec4(data.position, 1.0);
 	
 	// Compute lighting data
-	vec3 color = computeLighting(data.color, data.color, Material.specularColor, data.shininess, data.position, data.normal, positionLight);
+	vec3 color = computeLighting(data.color, data.color, Material.specularColor, data.shininess, data.position, data.normal);
+	color += computeClusteredLights(data, Material.specularColor);
 	fragColor = vec4(color, 1.0);
 }
@@ -1,19 +1,70 @@
 #version 450
 
+#include "gbuffer.glsl"
+#include "ssrUpsample.glsl"
+
 uniform sampler2D ResolveTexture;
 uniform isampler2D SSRTexcoordTexture;
 uniform sampler2D SSRVisibilityTexture;
+uniform int TraceScale;
+
+// Unset when the reflections were not traced this frame
+uniform bool DrawReflections;
+
+// Set when the reflections were already resolved at the traced resolution
+uniform bool UseReflectionTexture;
+uniform sampler2D ReflectionTexture;
 
 out vec4 fragColor;
 
+vec4 reflectionAt(ivec2 ssrCoord)
+{
+	if (UseReflectionTexture) return vec4(texelFetch(ReflectionTexture, ssrCoord, 0).rgb, 0.0);
+
+	ivec2 hitCoord = texelFetch(SSRTexcoordTexture, ssrCoord, 0).xy;
+	float visibility = texelFetch(SSRVisibilityTexture, ssrCoord, 0).r;
+	if (hitCoord.x >= 0 && hitCoord.y >= 0)
+		return texelFetch(ResolveTexture, hitCoord, 0) * visibility;
+	return vec4(0.0);
+}
+
+// Blends the reflections of the four traced pixels around this one
+vec4 upsampleReflection(ivec2 fragCoord)
+{
+	ivec2 ssrSize = UseReflectionTexture ? textureSize(ReflectionTexture, 0) : textureSize(SSRTexcoordTexture, 0);
+	vec2 ssrPos = vec2(fragCoord) / TraceScale;
+	ivec2 base = ivec2(floor(ssrPos));
+	vec2 f = fract(ssrPos);
+
+	float depth = linearDepth(fragCoord);
+	vec3 normal = readNormalFromGbuffer(fragCoord);
+
+	vec4 result = vec4(0.0);
+	float totalWeight = 0.0;
+	for (int j = 0; j <= 1; j++)
+		for (int i = 0; i <= 1; i++)
+		{
+			ivec2 ssrCoord = min(base + ivec2(i, j), ssrSize - 1);
+			ivec2 tracedCoord = min(ssrCoord * TraceScale, ivec2(ScreenSize) - 1);
+
+			float bilinear = (i == 0 ? 1.0 - f.x : f.x) * (j == 0 ? 1.0 - f.y : f.y);
+			float weight = upsampleWeight(bilinear, depth, normal, linearDepth(tracedCoord), readNormalFromGbuffer(tracedCoord));
+			result += reflectionAt(ssrCoord) * weight;
+			totalWeight += weight;
+		}
+
+	// No neighbor is on the same surface, so just take the closest one
+	if (totalWeight < 1e-4) return reflectionAt(min(ivec2(round(ssrPos)), ssrSize - 1));
+	return result / totalWeight;
+}
+
 void main()
 {
 	ivec2 fragCoord = ivec2(gl_FragCoord.xy);
 	fragColor = texelFetch(ResolveTexture, fragCoord, 0);
 
-	ivec2 ssrCoord = texelFetch(SSRTexcoordTexture, fragCoord, 0).xy;
-	float visibility = texelFetch(SSRVisibilityTexture, fragCoord, 0).r;
-	if (ssrCoord.x >= 0 && ssrCoord.y >= 0)
-		fragColor += texelFetch(ResolveTexture, ssrCoord, 0) * visibility;
+	// The background has no reflections
+	if (DrawReflections && texelFetch(DepthTexture, fragCoord, 0).r < 1.0)
+		fragColor += TraceScale == 1 ? reflectionAt(fragCoord) : upsampleReflection(fragCoord);
 	fragColor.a = 1.0;
 }
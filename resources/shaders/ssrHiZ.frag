@@ -0,0 +1,116 @@
+#version 450
+
+#include "gbuffer.glsl"
+
+const int MaxIterations = 96;
+const float StartPixels = 2.0;
+const float Epsilon = 0.001;
+
+uniform mat4 Projection;
+
+// The rays are traced for one pixel out of TraceScale in each direction
+uniform int TraceScale;
+
+// Each fragment traces one pixel out of each TraceInterleave x TraceInterleave block, the others come from the history
+uniform int TraceInterleave;
+uniform ivec2 TraceOffset;
+uniform sampler2D HiZTexture;
+
+layout(location = 0) out ivec2 ssrTexcoords;
+layout(location = 1) out float visibility;
+
+// Only kept when the reflections are reused over time
+uniform sampler2D ResolveTexture;
+layout(location = 2) out vec4 reflectedColor;
+
+// Window coordinates: x and y in pixels, z the depth in [0, 1]
+vec3 toWindow(vec4 clip)
+{
+	return vec3((clip.xy / clip.w * 0.5 + 0.5) * ScreenSize, clip.z / clip.w * 0.5 + 0.5);
+}
+
+void main()
+{
+	ssrTexcoords = ivec2(-1, -1);
+	visibility = 0.0;
+	ivec2 traceCoord = ivec2(gl_FragCoord.xy) * TraceInterleave + TraceOffset;
+	GBufferData data = readFromGbuffer(min(traceCoord * TraceScale, ivec2(ScreenSize) - 1));
+
+	vec3 norm = normalize(data.normal);
+	vec3 dir = normalize(data.position);
+
+	// Reflect the light direction
+	vec3 reflectedDir = reflect(dir, norm);
+
+	// Build the ray in window space, where depth varies linearly, clipping it to the near plane
+	float near = Projection[3][2] / (Projection[2][2] - 1.0);
+	float rayLength = reflectedDir.z > 0.0 ? min(1000.0, 0.99 * (-near - data.position.z) / reflectedDir.z) : 1000.0;
+
+	vec3 origin = toWindow(Projection * vec4(data.position, 1.0));
+	vec3 ray = toWindow(Projection * vec4(data.position + reflectedDir * rayLength, 1.0)) - origin;
+
+	// The ray ends when it leaves the screen
+	vec2 tScreen = mix((ScreenSize - origin.xy) / ray.xy, -origin.xy / ray.xy, lessThan(ray.xy, vec2(0.0)));
+	if (ray.x == 0.0) tScreen.x = 1.0;
+	if (ray.y == 0.0) tScreen.y = 1.0;
+	float tMax = min(1.0, min(tScreen.x, tScreen.y));
+
+	// Start a bit away from the surface, so it does not hit itself
+	float pixelsPerT = max(abs(ray.x), abs(ray.y));
+	if (pixelsPerT < 1.0) { discard; return; }
+	float t = StartPixels / pixelsPerT;
+
+	int maxLevel = textureQueryLevels(HiZTexture) - 1;
+	int level = 0;
+
+	// Walk down the min-depth pyramid: whole cells are skipped while the ray stays in front of everything in them
+	int i;
+	for (i = 0; i < MaxIterations && level >= 0; i++)
+	{
+		if (t >= tMax) { discard; return; }
+		vec3 pos = origin + ray * t;
+
+		float cellSize = float(1 << level);
+		ivec2 cell = ivec2(pos.xy / cellSize);
+		float minDepth = texelFetch(HiZTexture, min(cell, textureSize(HiZTexture, level) - 1), level).r;
+
+		if (pos.z >= minDepth)
+		{
+			// Behind something in this cell, so look closer
+			level--;
+			continue;
+		}
+
+		// Where the ray leaves the cell, and where it reaches the closest depth inside it
+		vec2 boundary = (vec2(cell) + step(vec2(0.0), ray.xy)) * cellSize;
+		vec2 tBoundary = (boundary - origin.xy) / ray.xy;
+		if (ray.x == 0.0) tBoundary.x = 1e30;
+		if (ray.y == 0.0) tBoundary.y = 1e30;
+		float tExit = min(tBoundary.x, tBoundary.y);
+		float tDepth = ray.z > 0.0 ? (minDepth - origin.z) / ray.z : 1e30;
+
+		if (tDepth < tExit)
+		{
+			t = max(t, tDepth);
+			level--;
+		}
+		else
+		{
+			t = tExit + 0.01 / pixelsPerT;
+			level = min(level + 1, maxLevel);
+		}
+	}
+
+	// If we didn't find any reflection, just discard
+	if (level >= 0) { discard; return; }
+
+	// Reject the rays which went behind the surface instead of hitting it
+	vec3 hit = origin + ray * t;
+	ssrTexcoords = ivec2(hit.xy);
+	float sampleDepth = texelFetch(DepthTexture, ssrTexcoords, 0).r;
+	if (abs(hit.z - sampleDepth) >= Epsilon) { discard; return; }
+
+	// Set the visibility
+	visibility = clamp(data.specular * (1.0 - exp(-data.shininess/12.5)), 0.0, 1.0);
+	reflectedColor = texelFetch(ResolveTexture, ssrTexcoords, 0) * visibility;
+}
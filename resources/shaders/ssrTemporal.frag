@@ -0,0 +1,79 @@
+#version 450
+
+#include "gbuffer.glsl"
+
+// How far (relative to the depth) the reprojected surface can be from the history before it is rejected
+const float DisocclusionThreshold = 0.02;
+
+uniform sampler2D SSRColorTexture;
+uniform sampler2D HistoryTexture;
+uniform mat4 Projection;
+uniform mat4 Reprojection;
+uniform int TraceScale;
+uniform int TraceInterleave;
+uniform ivec2 TraceOffset;
+uniform bool HistoryValid;
+
+// Only one pixel of each TraceInterleave x TraceInterleave block was traced, and the traced
+// pixels are packed together in the SSR textures
+
+// The alpha keeps the view space depth, zero meaning there is no surface
+out vec4 reflection;
+
+vec3 tracedReflection(ivec2 coord)
+{
+	return texelFetch(SSRColorTexture, coord, 0).rgb;
+}
+
+void main()
+{
+	ivec2 coord = ivec2(gl_FragCoord.xy);
+	ivec2 sourceCoord = min(coord * TraceScale, ivec2(ScreenSize) - 1);
+
+	float depth = texelFetch(DepthTexture, sourceCoord, 0).r;
+	if (depth == 1.0) { reflection = vec4(0.0); return; }
+
+	vec3 deviceCoords = 2.0 * vec3((vec2(sourceCoord) + 0.5) / ScreenSize, depth) - 1.0;
+	vec4 homogeneousPos = InverseProjection * vec4(deviceCoords, 1.0);
+	vec3 position = homogeneousPos.xyz / homogeneousPos.w;
+
+	// The pixels traced in this frame are always fresh
+	if (all(equal(coord % TraceInterleave, TraceOffset)))
+	{
+		reflection = vec4(tracedReflection(coord / TraceInterleave), position.z);
+		return;
+	}
+
+	// Find where the surface was in the last frame
+	vec3 lastPosition = (Reprojection * vec4(position, 1.0)).xyz;
+	vec4 lastClip = Projection * vec4(lastPosition, 1.0);
+	vec2 lastScreen = (lastClip.xy / lastClip.w * 0.5 + 0.5) * ScreenSize;
+	ivec2 lastCoord = ivec2(round((lastScreen - 0.5) / TraceScale));
+
+	if (HistoryValid && lastClip.w > 0.0 && all(greaterThanEqual(lastCoord, ivec2(0))) && all(lessThan(lastCoord, textureSize(HistoryTexture, 0))))
+	{
+		// If another surface was there, it was just disoccluded and the history does not apply
+		vec4 history = texelFetch(HistoryTexture, lastCoord, 0);
+		if (history.a != 0.0 && abs(history.a - lastPosition.z) < DisocclusionThreshold * abs(lastPosition.z))
+		{
+			// The reflections also move on their own with the camera, so keep the history
+			// within the range of the four pixels traced around this one to avoid ghosting
+			ivec2 tracedSize = textureSize(SSRColorTexture, 0);
+			ivec2 tracedBase = ivec2(floor(vec2(coord - TraceOffset) / TraceInterleave));
+			vec3 minReflection = vec3(1.0), maxReflection = vec3(0.0);
+			for (int j = 0; j <= 1; j++)
+				for (int i = 0; i <= 1; i++)
+				{
+					vec3 neighbor = tracedReflection(clamp(tracedBase + ivec2(i, j), ivec2(0), tracedSize - 1));
+					minReflection = min(minReflection, neighbor);
+					maxReflection = max(maxReflection, neighbor);
+				}
+
+			reflection = vec4(clamp(history.rgb, minReflection, maxReflection), position.z);
+			return;
+		}
+	}
+
+	// Otherwise, take the pixel traced in this frame in the same block
+	reflection = vec4(tracedReflection(coord / TraceInterleave), position.z);
+}
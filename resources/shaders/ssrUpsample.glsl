@@ -0,0 +1,21 @@
+//? #version 450
+
+// Needs gbuffer.glsl to be included first
+
+const float DepthSigma = 0.05;
+const float NormalPower = 16.0;
+
+float linearDepth(ivec2 fragCoord)
+{
+	float depth = texelFetch(DepthTexture, fragCoord, 0).r;
+	vec4 viewPos = InverseProjection * vec4(0.0, 0.0, 2.0 * depth - 1.0, 1.0);
+	return viewPos.z / viewPos.w;
+}
+
+// Weights out the traced pixels which lie on another surface, so the reflections do not bleed across edges
+float upsampleWeight(float bilinear, float depth, vec3 normal, float tracedDepth, vec3 tracedNormal)
+{
+	float depthWeight = exp(-abs(tracedDepth - depth) / (DepthSigma * abs(depth)));
+	float normalWeight = pow(max(dot(tracedNormal, normal), 0.0), NormalPower);
+	return bilinear * depthWeight * normalWeight;
+}
@@ -0,0 +1,81 @@
+#include "FrustumCulling.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <utility>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "util/Frustum.hpp"
+
+using namespace benchmark;
+using HighClock = std::chrono::high_resolution_clock;
+
+constexpr int Repetitions = 16;
+
+template <typename F>
+static double timeMs(F func)
+{
+    auto then = HighClock::now();
+    for (int i = 0; i < Repetitions; i++) func();
+    return std::chrono::duration<double, std::milli>(HighClock::now() - then).count() / Repetitions;
+}
+
+int benchmark::runFrustumCulling(std::size_t numBoxes)
+{
+    // Scatter the boxes around a camera at the origin, so roughly a fifth of them are visible
+    std::mt19937 engine(0);
+    std::uniform_real_distribution position(-100.0f, 100.0f);
+    std::uniform_real_distribution size(0.5f, 4.0f);
+
+    std::vector<std::pair<glm::vec3, glm::vec3>> boxes;
+    util::AABBList boxList;
+    boxes.reserve(numBoxes);
+    for (std::size_t i = 0; i < numBoxes; i++)
+    {
+        auto min = glm::vec3(position(engine), position(engine), position(engine));
+        auto max = min + glm::vec3(size(engine), size(engine), size(engine));
+        boxes.emplace_back(min, max);
+        boxList.push_back(min, max);
+    }
+
+    auto projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+    auto view = glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(1, 0.2f, 0.5f), glm::vec3(0, 1, 0));
+    auto frustum = util::frustumPlanes(projection * view);
+
+    std::vector<std::uint8_t> single(numBoxes), scalar(numBoxes), simd(numBoxes);
+    auto singleTime = timeMs([&]
+    {
+        for (std::size_t i = 0; i < numBoxes; i++)
+            single[i] = frustum.checkIntersectionAABB(boxes[i].first, boxes[i].second);
+    });
+    auto scalarTime = timeMs([&] { frustum.checkIntersectionAABBsScalar(boxList, scalar.data()); });
+    auto simdTime = timeMs([&] { frustum.checkIntersectionAABBs(boxList, simd.data()); });
+
+    std::size_t visible = 0, mismatches = 0;
+    for (std::size_t i = 0; i < numBoxes; i++)
+    {
+        visible += simd[i];
+        if (single[i] != simd[i] || scalar[i] != simd[i]) mismatches++;
+    }
+
+    auto throughput = [&](double ms) { return numBoxes / (ms * 1000.0); };
+
+#if defined(__AVX__)
+    const char* simdName = "AVX";
+#elif defined(FRUSTUM_SIMD)
+    const char* simdName = "SSE";
+#else
+    const char* simdName = "none";
+#endif
+
+    std::cout << numBoxes << " boxes, " << visible << " visible, " << mismatches << " mismatches\n";
+    std::cout << std::setw(24) << "one at a time: " << std::setw(10) << singleTime << "ms, " << throughput(singleTime) << " Mboxes/s\n";
+    std::cout << std::setw(24) << "batched scalar: " << std::setw(10) << scalarTime << "ms, " << throughput(scalarTime) << " Mboxes/s\n";
+    std::cout << std::setw(24) << std::string("batched SIMD (") + simdName + "): " << std::setw(10) << simdTime << "ms, "
+        << throughput(simdTime) << " Mboxes/s" << std::endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
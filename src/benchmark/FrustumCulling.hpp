@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace benchmark
+{
+    // Compares the throughput of the frustum-AABB tests (one at a time, batched scalar and batched SIMD)
+    // over numBoxes random boxes. It only exercises the CPU side, so no OpenGL context is needed
+    int runFrustumCulling(std::size_t numBoxes);
+}
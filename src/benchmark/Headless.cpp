@@ -0,0 +1,239 @@
+#include "Headless.hpp"
+
+#include <glad/glad.h>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+
+#include "scene/Scene.hpp"
+#include "resources/Framebuffer.hpp"
+#include "resources/Renderbuffer.hpp"
+#include "resources/FileUtils.hpp"
+#include "resources/Cache.hpp"
+
+#ifdef ENABLE_HEADLESS
+#include "wrappers/egl.hpp"
+#endif
+
+using namespace benchmark;
+using HighClock = std::chrono::high_resolution_clock;
+
+void enableOpenGLErrorHandler();
+
+std::size_t benchmark::parseCount(std::string_view option, const char* value)
+{
+    // std::stoul would take a minus sign and wrap the value around, so only plain digits are accepted
+    std::size_t count = 0, end = 0;
+    try { if (std::isdigit((unsigned char)value[0])) count = std::stoul(value, &end); }
+    catch (const std::exception&) { end = 0; }
+
+    if (end == 0 || value[end] != '\0') throw OptionsException("Invalid value for " + std::string(option) + ": " + value);
+    return count;
+}
+
+HeadlessOptions benchmark::parseHeadlessOptions(int argc, char** argv)
+{
+    HeadlessOptions options;
+
+    for (int i = 0; i < argc; i++)
+    {
+        auto option = std::string_view(argv[i]);
+        auto value = [&]
+        {
+            if (i + 1 >= argc) throw OptionsException("Missing value for " + std::string(option));
+            return argv[++i];
+        };
+
+        if (option == "--size")
+        {
+            auto size = std::string_view(value());
+            auto x = size.find('x');
+            if (x == std::string_view::npos) throw OptionsException("Invalid size, expected WxH: " + std::string(size));
+            options.width = (int)parseCount(option, std::string(size.substr(0, x)).c_str());
+            options.height = (int)parseCount(option, std::string(size.substr(x + 1)).c_str());
+        }
+        else if (option == "--frames") options.frames = parseCount(option, value());
+        else if (option == "--warmup") options.warmupFrames = parseCount(option, value());
+        else if (option == "--seed") options.seed = (std::uint32_t)parseCount(option, value());
+        else if (option == "--output") options.output = value();
+        else if (option == "--no-ssr") options.enableSSR = false;
+        else if (option == "--hiz-ssr") options.hizSSR = true;
+        else if (option == "--ssr-scale")
+        {
+            options.ssrScale = (int)parseCount(option, value());
+            if (options.ssrScale != 1 && options.ssrScale != 2 && options.ssrScale != 4)
+                throw OptionsException("The SSR scale must be 1, 2 or 4!");
+        }
+        else if (option == "--temporal-ssr") options.temporalSSR = true;
+        else if (option == "--lights") options.localLights = parseCount(option, value());
+        else if (option == "--clustered-lights") options.clusteredLights = true;
+        else if (option == "--no-instancing") options.instancedBoxes = false;
+        else if (option == "--streamed-instances") options.streamedInstances = true;
+        else if (option == "--no-multi-draw") options.multiDraw = false;
+        else if (option == "--static-camera") options.staticCamera = true;
+        else if (option == "--no-occlusion") options.occlusionCulling = false;
+        else if (option == "--compact-gbuffer") options.compactGBuffer = true;
+        else if (option == "--fused-composite") options.fusedComposite = true;
+        else throw OptionsException("Unknown option " + std::string(option));
+    }
+
+    if (options.width <= 0 || options.height <= 0 || options.frames == 0)
+        throw OptionsException("The size and the number of frames must be positive!");
+
+    return options;
+}
+
+static void renderFrames(const HeadlessOptions& options, std::ostream& out)
+{
+    // There is no default framebuffer, so the final step draws here
+    gl::Renderbuffer colorbuffer;
+    colorbuffer.storage(gl::InternalFormat::RGBA8, options.width, options.height);
+    colorbuffer.setName("Headless Color Renderbuffer");
+
+    gl::Framebuffer framebuffer;
+    framebuffer.attach(gl::ColorAttachment(0), colorbuffer);
+    framebuffer.setName("Headless Framebuffer");
+    if (framebuffer.getStatus() != gl::FramebufferStatus::Complete)
+        throw std::runtime_error("Headless framebuffer is not complete!");
+
+    scene::Scene scene(glfw::Size{ options.width, options.height }, framebuffer, options.seed);
+    scene.setSSREnabled(options.enableSSR);
+    scene.setSSRMode(options.hizSSR ? scene::SSRMode::HiZ : scene::SSRMode::Linear);
+    scene.setSSRScale(options.ssrScale);
+    scene.setSSRTemporal(options.temporalSSR);
+    scene.setInstancedBoxes(options.instancedBoxes);
+    scene.setStreamedInstances(options.streamedInstances);
+    scene.setMultiDraw(options.multiDraw);
+    scene.generateLocalLights(options.localLights);
+    scene.setClusteredLights(options.clusteredLights);
+    scene.setOcclusionCulling(options.occlusionCulling);
+    scene.setFusedComposite(options.fusedComposite);
+    scene.setGBufferLayout(options.compactGBuffer ? scene::GBufferLayout::Compact : scene::GBufferLayout::Wide);
+
+    auto toMs = [](GLuint64 ns) { return ns / 1000000.0; };
+    // The zones are summed by name, in the order they run
+    std::vector<scene::GpuProfiler::Zone> zoneSums;
+    double clusterTime = 0, occlusionTime = 0;
+    std::size_t arenaDraws = 0, arenaSubmits = 0;
+
+    out << "frame,gbuffer_ms,shadow_ms,resolve_ms,local_lights_ms,ssr_ms,final_step_ms,gpu_total_ms,cpu_frame_ms,cluster_build_ms,occlusion_ms,state_changes_issued,state_changes_elided,"
+        "camera_visible,camera_culled,camera_occluded,shadow_visible,shadow_culled,shadow_cascades_drawn,"
+        "composite_passes,intermediate_kib\n";
+
+    auto totalFrames = options.warmupFrames + options.frames;
+    for (std::size_t i = 0; i < totalFrames; i++)
+    {
+        // The warmup frames run over the start of the path
+        auto frame = i < options.warmupFrames ? 0 : i - options.warmupFrames;
+        scene.followCameraPath(options.staticCamera ? 0.0f : (float)frame / options.frames);
+
+        auto then = HighClock::now();
+        scene.draw();
+
+        // Waiting makes this frame's queries available right away
+        glFinish(); gl::checkError();
+        auto cpuTime = std::chrono::duration<double, std::milli>(HighClock::now() - then).count();
+        scene.getQueryResults();
+
+        if (i < options.warmupFrames) continue;
+
+        const auto& profiler = scene.getProfiler();
+        const auto& c = scene.getLastStateCounters();
+        using Scene = scene::Scene;
+        out << frame << ',' << toMs(profiler.getLastTime(Scene::GBufferZone)) << ',' << toMs(profiler.getLastTime(Scene::ShadowZone)) << ','
+            << toMs(profiler.getLastTime(Scene::ResolveZone)) << ',' << toMs(profiler.getLastTime(Scene::LocalLightsZone)) << ','
+            << toMs(profiler.getLastTime(Scene::SSRZone)) << ',' << toMs(profiler.getLastTime(Scene::FinalStepZone)) << ','
+            << toMs(profiler.getLastTotal()) << ',' << cpuTime << ',' << scene.getLastClusterTime() << ','
+            << scene.getLastOcclusionTime() << ','
+            << c.issued << ',' << c.elided << ',' << scene.getLastCameraCulling().visible << ',' << scene.getLastCameraCulling().culled << ','
+            << scene.getLastCameraCulling().occluded << ','
+            << scene.getLastShadowCulling().visible << ',' << scene.getLastShadowCulling().culled << ','
+            << scene.getLastShadowCascadesDrawn() << ',' << scene.getLastCompositeStats().passes << ','
+            << scene.getLastCompositeStats().intermediateBytes / 1024.0 << '\n';
+
+        // A zone seen for the first time goes after the one before it in this frame
+        auto next = zoneSums.begin();
+        for (const auto& zone : profiler.getLastZones())
+        {
+            auto it = std::ranges::find(zoneSums, zone.name, &scene::GpuProfiler::Zone::name);
+            if (it == zoneSums.end()) it = zoneSums.insert(next, zone);
+            else it->time += zone.time;
+            next = it + 1;
+        }
+        clusterTime += scene.getLastClusterTime();
+        occlusionTime += scene.getLastOcclusionTime();
+        arenaDraws += scene.getLastArenaStats().draws;
+        arenaSubmits += scene.getLastArenaStats().submits;
+    }
+
+    auto n = (double)options.frames;
+    std::cout << "Average over " << options.frames << " frames at " << options.width << 'x' << options.height << ":\n";
+    for (const auto& zone : zoneSums)
+        std::cout << std::string(2 + 2 * zone.depth, ' ') << zone.name << ": " << toMs(zone.time) / n << "ms\n";
+    std::cout << "  Light Cluster Assignment (CPU): " << clusterTime / n << "ms\n";
+    std::cout << "  Occluder Rasterization (CPU): " << occlusionTime / n << "ms\n";
+    if (scene.getProfiler().getDroppedFrames() > 0)
+        std::cout << "  Frames dropped by the GPU profiler: " << scene.getProfiler().getDroppedFrames() << '\n';
+
+    auto traffic = scene::measureGBufferTraffic(scene.getGBufferLayout());
+    std::cout << "G-buffer layout: " << scene::describeGBuffer(scene.getGBufferLayout()).name << ", bytes per pixel: " << traffic.written
+        << " written, " << traffic.resolveRead << " read by the resolve, " << traffic.ssrRead << " by each reflection, "
+        << traffic.ssrNormalRead << " by each upsampling tap\n";
+    const auto& graph = scene.getLastFrameGraphStats();
+    std::cout << "Frame graph: " << graph.passes << " passes, " << graph.culledPasses << " culled, " << graph.transientTextures
+        << " transient textures in " << graph.physicalTextures << ", render targets: " << graph.unaliasedBytes / 1024.0
+        << "KiB each on its own, " << graph.allocatedBytes / 1024.0 << "KiB allocated\n";
+    const auto& stream = scene.getStreamBuffer().getStats();
+    std::cout << "Stream buffer: " << stream.bytes / 1024.0 / stream.frames << "KiB per frame in " << stream.allocations
+        << " allocations over " << stream.frames << " frames, " << stream.wraps << " wraps around "
+        << scene.getStreamBuffer().getCapacity() / 1024.0 << "KiB, " << stream.stalls << " stalls in " << stream.stallTime << "ms\n";
+    std::cout << "Arena meshes: " << arenaDraws / n << " draws in " << arenaSubmits / n << " multi-draw calls per frame\n";
+    std::cout << "Crate triangles: " << scene.getBoxTriangleCount() << '\n';
+    std::cout << "Geometry buffers: " << scene.getGeometryMemoryUsage() / 1024.0 << "KiB" << std::endl;
+
+    // The last frame is still in the buffers, so its binning can be checked against the CPU
+    if (options.localLights > 0 && !options.clusteredLights)
+        std::cout << "Light tiles differing from the CPU binning: " << scene.checkLightBinning() << std::endl;
+}
+
+int benchmark::runHeadless(const HeadlessOptions& options)
+{
+#ifdef ENABLE_HEADLESS
+#ifndef NDEBUG
+    constexpr bool DebugContext = true;
+#else
+    constexpr bool DebugContext = false;
+#endif
+
+    egl::HeadlessContext context(4, 5, DebugContext);
+    context.makeCurrent();
+
+    // The cached GL objects are released while the context is still alive, even when the benchmark throws
+    struct CacheGuard { ~CacheGuard() { cache::clear(); } } cacheGuard;
+
+    if (!gladLoadGLLoader((GLADloadproc)egl::getProcAddress))
+        throw std::runtime_error("Failed to initialize GLAD!");
+
+    std::cout << "Using OpenGL " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER) << std::endl;
+
+#ifndef NDEBUG
+    enableOpenGLErrorHandler();
+#endif
+
+    std::ofstream out(options.output);
+    if (!out) throw std::runtime_error("Unable to open file " + options.output.string());
+
+    fileUtils::addDefaultLoaders();
+    fileUtils::addGeneratedInclude(scene::GBufferShaderInclude, scene::generateGBufferShaderCode());
+    renderFrames(options, out);
+
+    std::cout << "Frame timings written to " << options.output << std::endl;
+    return 0;
+#else
+    std::cerr << "This build has no headless support: EGL was not found when configuring." << std::endl;
+    return 1;
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace benchmark
+{
+    struct HeadlessOptions
+    {
+        int width = 1920, height = 1080;
+        std::size_t warmupFrames = 16;
+        std::size_t frames = 256;
+        bool enableSSR = true;
+        bool hizSSR = false;
+        int ssrScale = 1;
+        bool temporalSSR = false;
+        std::size_t localLights = 0;
+        bool clusteredLights = false;
+        bool instancedBoxes = true;
+        bool streamedInstances = false;
+        bool multiDraw = true;
+        bool staticCamera = false;
+        bool occlusionCulling = true;
+        bool compactGBuffer = false;
+        bool fusedComposite = false;
+        std::uint32_t seed = 0;
+        std::filesystem::path output = "frameTimes.csv";
+    };
+
+    class OptionsException : public std::runtime_error
+    {
+    public:
+        OptionsException(std::string what) : std::runtime_error(what) {}
+    };
+
+    // A non-negative integer given to an option, throws OptionsException otherwise
+    std::size_t parseCount(std::string_view option, const char* value);
+
+    // Accepts --size WxH, --frames N, --warmup N, --seed N, --no-ssr, --hiz-ssr, --ssr-scale N, --temporal-ssr, --lights N, --clustered-lights, --no-instancing, --streamed-instances, --no-multi-draw, --static-camera, --no-occlusion, --compact-gbuffer, --fused-composite and --output file.csv
+    HeadlessOptions parseHeadlessOptions(int argc, char** argv);
+
+    // Renders the scene offscreen along a scripted camera path and writes the per-pass timings to a CSV file
+    int runHeadless(const HeadlessOptions& options);
+}
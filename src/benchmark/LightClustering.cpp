@@ -0,0 +1,77 @@
+#include "LightClustering.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene/LightClusters.hpp"
+
+using namespace benchmark;
+using HighClock = std::chrono::high_resolution_clock;
+
+constexpr int Repetitions = 16;
+
+template <typename F>
+static double timeMs(F func)
+{
+    auto then = HighClock::now();
+    for (int i = 0; i < Repetitions; i++) func();
+    return std::chrono::duration<double, std::milli>(HighClock::now() - then).count() / Repetitions;
+}
+
+int benchmark::runLightClustering(std::size_t numLights)
+{
+    // Same projection as the scene's camera at 1080p, with the lights scattered over its first hundred units
+    auto projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.5f, 150.0f);
+    scene::LightClusterBuilder builder;
+    builder.setProjection(projection);
+
+    std::mt19937 engine(0);
+    std::uniform_real_distribution side(-40.0f, 40.0f);
+    std::uniform_real_distribution depth(-100.0f, 0.0f);
+    std::uniform_real_distribution radius(0.75f, 4.0f);
+
+    std::vector<scene::LightSphere> lights(numLights);
+    for (auto& light : lights)
+        light = { glm::vec3(side(engine), side(engine), depth(engine)), radius(engine) };
+
+    scene::LightClusters scalar, simd, threaded;
+    auto threads = std::max(std::thread::hardware_concurrency(), 1u);
+    auto scalarTime = timeMs([&] { scalar = builder.assignLightsScalar(lights); });
+    auto simdTime = timeMs([&] { simd = builder.assignLights(lights, 1); });
+    auto threadedTime = timeMs([&] { threaded = builder.assignLights(lights, threads); });
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < scene::NumClusters; i++)
+    {
+        auto lights = [i](const scene::LightClusters& clusters)
+        {
+            auto range = clusters.ranges[i];
+            return std::vector<std::uint32_t>(clusters.indices.begin() + range.x, clusters.indices.begin() + range.x + range.y);
+        };
+
+        auto expected = lights(scalar);
+        if (lights(simd) != expected || lights(threaded) != expected) mismatches++;
+    }
+
+#if defined(__AVX__)
+    const char* simdName = "AVX";
+#elif defined(__SSE__) || defined(_M_X64)
+    const char* simdName = "SSE";
+#else
+    const char* simdName = "none";
+#endif
+
+    std::cout << numLights << " lights, " << scene::NumClusters << " clusters, " << scalar.indices.size() << " light references, "
+        << mismatches << " mismatches\n";
+    std::cout << std::setw(28) << "reference: " << std::setw(10) << scalarTime << "ms\n";
+    std::cout << std::setw(28) << std::string("SIMD (") + simdName + "), 1 thread: " << std::setw(10) << simdTime << "ms\n";
+    std::cout << std::setw(28) << std::string("SIMD, ") + std::to_string(threads) + (threads == 1 ? " thread: " : " threads: ") << std::setw(10) << threadedTime
+        << "ms" << std::endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+namespace benchmark
+{
+    // Compares the time taken to assign numLights random lights to the clusters of the view frustum
+    // with the reference loop, with SIMD on one thread and with SIMD on all the hardware threads.
+    // It only exercises the CPU side, so no OpenGL context is needed
+    int runLightClustering(std::size_t numLights);
+}
@@ -0,0 +1,62 @@
+#include "MeshGeneration.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cmath>
+
+#include "scene/meshUtils.hpp"
+
+using namespace benchmark;
+using HighClock = std::chrono::high_resolution_clock;
+
+static std::vector<gl::MeshBuilder> generateBoxes(std::size_t count)
+{
+    std::vector<gl::MeshBuilder> boxes;
+    boxes.reserve(count);
+
+    // Lay them on a square grid, like the crates of the scene
+    auto side = (std::size_t)std::ceil(std::sqrt((double)count));
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto min = glm::vec3(i % side, 0, i / side);
+        boxes.push_back(meshUtils::addParameters(meshUtils::box(min, min + glm::vec3(1, 1, 1)), glm::u8vec4(255), 16.0f));
+    }
+
+    return boxes;
+}
+
+template <typename F>
+static double timeMs(F func)
+{
+    auto then = HighClock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(HighClock::now() - then).count();
+}
+
+int benchmark::runMeshGeneration(std::size_t maxBoxes)
+{
+    std::cout << std::setw(10) << "boxes" << std::setw(16) << "append (ms)" << std::setw(16) << "batched (ms)"
+        << std::setw(16) << "ns/box" << '\n';
+
+    for (std::size_t count = 1000; count <= maxBoxes; count *= 10)
+        for (auto step : { 1, 2, 5 })
+        {
+            auto numBoxes = count * step;
+            if (numBoxes > maxBoxes) break;
+            auto boxes = generateBoxes(numBoxes);
+
+            // One box at a time, as the scene used to do
+            gl::MeshBuilder appended;
+            auto appendTime = timeMs([&] { for (const auto& box : boxes) appended += box; });
+
+            gl::MeshBuilder batched;
+            auto batchTime = timeMs([&] { batched.append(boxes); });
+
+            std::cout << std::setw(10) << numBoxes << std::setw(16) << appendTime << std::setw(16) << batchTime
+                << std::setw(16) << batchTime * 1000000.0 / numBoxes << std::endl;
+        }
+
+    return 0;
+}
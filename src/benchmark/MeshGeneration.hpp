@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace benchmark
+{
+    // Times how long appending boxes to a MeshBuilder takes for increasing box counts, up to maxBoxes.
+    // It only exercises the CPU side, so no OpenGL context is needed
+    int runMeshGeneration(std::size_t maxBoxes);
+}
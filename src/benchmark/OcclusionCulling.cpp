@@ -0,0 +1,105 @@
+#include "OcclusionCulling.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene/OcclusionBuffer.hpp"
+
+using namespace benchmark;
+using HighClock = std::chrono::high_resolution_clock;
+
+constexpr int Repetitions = 16;
+constexpr std::size_t NumObjects = 16384;
+
+template <typename F>
+static double timeMs(F func)
+{
+    auto then = HighClock::now();
+    for (int i = 0; i < Repetitions; i++) func();
+    return std::chrono::duration<double, std::milli>(HighClock::now() - then).count() / Repetitions;
+}
+
+struct Box { glm::vec3 min, max; };
+
+int benchmark::runOcclusionCulling(std::size_t numOccluders)
+{
+    // Same projection as the scene's camera at 1080p, standing on a floor covered with pillars
+    auto projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.5f, 150.0f);
+    auto view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    auto viewProjection = projection * view;
+
+    std::mt19937 engine(0);
+    std::uniform_real_distribution side(-40.0f, 40.0f);
+    std::uniform_real_distribution depth(-100.0f, -4.0f);
+    std::uniform_real_distribution width(1.0f, 4.0f);
+    std::uniform_real_distribution height(1.0f, 6.0f);
+    std::uniform_real_distribution size(0.25f, 1.5f);
+
+    auto randomBoxes = [&](std::size_t count, auto& width, auto& height)
+    {
+        std::vector<Box> boxes(count);
+        for (auto& box : boxes)
+        {
+            auto min = glm::vec3(side(engine), 0.0f, depth(engine));
+            box = { min, min + glm::vec3(width(engine), height(engine), width(engine)) };
+        }
+        return boxes;
+    };
+
+    auto occluders = randomBoxes(numOccluders, width, height);
+    auto objects = randomBoxes(NumObjects, size, size);
+
+    // Every version gets its own buffer, so their results can be compared at the end
+    auto prepare = [&](scene::OcclusionBuffer& buffer)
+    {
+        buffer.clear(viewProjection);
+        for (const auto& box : occluders) buffer.addBox(box.min, box.max);
+    };
+
+    scene::OcclusionBuffer scalar, simd, threaded;
+    prepare(scalar);
+    prepare(simd);
+    prepare(threaded);
+
+    auto threads = std::max(std::thread::hardware_concurrency(), 1u);
+    auto setupTime = timeMs([&] { prepare(scalar); });
+    auto scalarTime = timeMs([&] { scalar.rasterize(false, 1); });
+    auto simdTime = timeMs([&] { simd.rasterize(true, 1); });
+    auto threadedTime = timeMs([&] { threaded.rasterize(true, threads); });
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < scalar.getDepth().size(); i++)
+        if (simd.getDepth()[i] != scalar.getDepth()[i] || threaded.getDepth()[i] != scalar.getDepth()[i]) mismatches++;
+
+    std::size_t occluded = 0;
+    auto testTime = timeMs([&]
+    {
+        occluded = 0;
+        for (const auto& box : objects)
+            if (!threaded.isVisible(box.min, box.max)) occluded++;
+    });
+
+#if defined(__AVX__)
+    const char* simdName = "AVX";
+#elif defined(__SSE__) || defined(_M_X64)
+    const char* simdName = "SSE";
+#else
+    const char* simdName = "none";
+#endif
+
+    std::cout << numOccluders << " occluders (" << scalar.getNumOccluders() << " on the screen), " << scene::OcclusionWidth << 'x'
+        << scene::OcclusionHeight << " pixels, " << mismatches << " mismatches\n";
+    std::cout << std::setw(28) << "occluder setup: " << std::setw(10) << setupTime << "ms\n";
+    std::cout << std::setw(28) << "reference: " << std::setw(10) << scalarTime << "ms\n";
+    std::cout << std::setw(28) << std::string("SIMD (") + simdName + "), 1 thread: " << std::setw(10) << simdTime << "ms\n";
+    std::cout << std::setw(28) << std::string("SIMD, ") + std::to_string(threads) + (threads == 1 ? " thread: " : " threads: ") << std::setw(10) << threadedTime
+        << "ms\n";
+    std::cout << NumObjects << " objects tested in " << testTime << "ms, " << occluded << " occluded" << std::endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+namespace benchmark
+{
+    // Compares the time taken to rasterize numOccluders random boxes into the occlusion buffer with the
+    // reference loop, with SIMD on one thread and with SIMD on all the hardware threads, then tests random
+    // objects against it. It only exercises the CPU side, so no OpenGL context is needed
+    int runOcclusionCulling(std::size_t numOccluders);
+}
@@ -10,6 +10,11 @@
 #include "scene/ImGuiS.hpp"
 #include "resources/FileUtils.hpp"
 #include "resources/Cache.hpp"
+#include "benchmark/Headless.hpp"
+#include "benchmark/MeshGeneration.hpp"
+#include "benchmark/FrustumCulling.hpp"
+#include "benchmark/LightClustering.hpp"
+#include "benchmark/OcclusionCulling.hpp"
 
 using HighClock = std::chrono::high_resolution_clock;
 
@@ -24,8 +29,48 @@ constexpr auto UpdatePeriodSeconds = toFloatSeconds(UpdatePeriod);
 
 void enableOpenGLErrorHandler();
 
-int main()
+// The count given after a benchmark flag, if any
+static std::size_t countArgument(int argc, char** argv, std::size_t defaultCount)
 {
+    return argc > 2 ? benchmark::parseCount(argv[1], argv[2]) : defaultCount;
+}
+
+int main(int argc, char** argv)
+{
+    // Offscreen benchmark mode, which does not need a display. It runs unattended, so its errors are reported as a failure
+    if (argc > 1 && std::string_view(argv[1]) == "--headless")
+    {
+        try { return benchmark::runHeadless(benchmark::parseHeadlessOptions(argc - 2, argv + 2)); }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Headless benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // CPU-only benchmarks, which can only fail on an invalid count
+    try
+    {
+        // CPU-only benchmark of the mesh generation
+        if (argc > 1 && std::string_view(argv[1]) == "--mesh-benchmark")
+            return benchmark::runMeshGeneration(countArgument(argc, argv, 100000));
+
+        if (argc > 1 && std::string_view(argv[1]) == "--frustum-benchmark")
+            return benchmark::runFrustumCulling(countArgument(argc, argv, 1000000));
+
+        if (argc > 1 && std::string_view(argv[1]) == "--cluster-benchmark")
+            return benchmark::runLightClustering(countArgument(argc, argv, 4096));
+
+        if (argc > 1 && std::string_view(argv[1]) == "--occlusion-benchmark")
+            return benchmark::runOcclusionCulling(countArgument(argc, argv, 256));
+    }
+    catch (const benchmark::OptionsException& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0] << ' ' << argv[1] << " [count]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     // Init GLFW
     glfw::InitGuard initGuard;
 
@@ -55,13 +100,9 @@ int main()
 #ifndef NDEBUG
     enableOpenGLErrorHandler();
 #endif
-    glEnable(GL_DEPTH_TEST); gl::checkError();
-    glDepthFunc(GL_LEQUAL); gl::checkError();
-    glEnable(GL_CULL_FACE); gl::checkError();
-    glCullFace(GL_BACK); gl::checkError();
-    glFrontFace(GL_CCW); gl::checkError();
 
     fileUtils::addDefaultLoaders();
+    fileUtils::addGeneratedInclude(scene::GBufferShaderInclude, scene::generateGBufferShaderCode());
     scene::Scene scene(window);
 
     auto then = HighClock::now();
@@ -84,6 +125,7 @@ int main()
         }
 
         scene.draw();
+        scene.drawGui();
         scene::endImGui();
         window.swapBuffers();
         glfw::pollEvents();
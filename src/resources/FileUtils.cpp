@@ -6,11 +6,19 @@
 #include <iostream>
 #include <stack>
 #include <vector>
+#include <unordered_map>
 #include "Cache.hpp"
 
 using namespace std::literals::string_view_literals;
 namespace fs = std::filesystem;
 
+static std::unordered_map<std::string, std::string> generatedIncludes;
+
+void fileUtils::addGeneratedInclude(std::string name, std::string source)
+{
+    generatedIncludes.insert_or_assign(std::move(name), std::move(source));
+}
+
 auto nextToken(const std::string_view& str, std::size_t val = 0)
 {
     auto nextNonSpace = str.find_first_not_of(" \t\r\n", val);
@@ -77,6 +85,7 @@ gl::Shader fileUtils::loadShader(fs::path path, gl::ShaderType type)
                     if (val == "vertex") target = gl::ShaderType::VertexShader;
                     else if (val == "geometry") target = gl::ShaderType::GeometryShader;
                     else if (val == "fragment") target = gl::ShaderType::FragmentShader;
+                    else if (val == "compute") target = gl::ShaderType::ComputeShader;
                     else throw gl::ShaderException("Unknown shader type declaration!");
 
                     if (type == gl::ShaderType::Unknown) type = target;
@@ -93,6 +102,16 @@ gl::Shader fileUtils::loadShader(fs::path path, gl::ShaderType type)
                     auto val = nextQuotes(linev, sizeof("#include") - 1);
                     if (val.empty()) throw gl::ShaderException("Invalid value for include!");
 
+                    // Generated code goes in place, then the file goes on from the next line
+                    auto generated = generatedIncludes.find(std::string(val));
+                    if (generated != generatedIncludes.end())
+                    {
+                        paths.push_back(val);
+                        output << "#line 1 " << paths.size() << '\n' << generated->second << '\n';
+                        output << "#line " << (lnumber + 1) << ' ' << pathId << '\n';
+                        continue;
+                    }
+
                     // Compute the path
                     auto nextPath = path.parent_path() / val;
 
@@ -157,4 +176,6 @@ void fileUtils::addDefaultLoaders()
         { return std::make_shared<gl::Shader>(loadShader(path, gl::ShaderType::GeometryShader)); });
     cache::addLoader(".frag", [](fs::path path) 
         { return std::make_shared<gl::Shader>(loadShader(path, gl::ShaderType::FragmentShader)); });
+    cache::addLoader(".comp", [](fs::path path) 
+        { return std::make_shared<gl::Shader>(loadShader(path, gl::ShaderType::ComputeShader)); });
 }
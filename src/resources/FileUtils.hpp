@@ -14,5 +14,8 @@ namespace fileUtils
 
     gl::Shader loadShader(std::filesystem::path path, gl::ShaderType type = gl::ShaderType::Unknown);
 
+    // Code generated at runtime, included by name instead of a file. It cannot include anything itself
+    void addGeneratedInclude(std::string name, std::string source);
+
     void addDefaultLoaders();
 }
@@ -2,9 +2,11 @@
 
 #include <glad/glad.h>
 #include <algorithm>
+#include <vector>
 
 #include "Texture.hpp"
 #include "Renderbuffer.hpp"
+#include "StateCache.hpp"
 #include "util/is_one_of.hpp"
 #include "wrappers/glException.hpp"
 
@@ -40,14 +42,13 @@ namespace gl
     class Framebuffer final
     {
         GLuint framebuffer;
-        static inline thread_local GLuint lastBoundFramebuffer = 0;
 
         explicit Framebuffer(int) : framebuffer(0) {};
     public:
         static Framebuffer none() { return Framebuffer(-1); }
 
-        Framebuffer() { glGenFramebuffers(1, &framebuffer); gl::checkError(); }
-        ~Framebuffer() { glDeleteFramebuffers(1, &framebuffer); gl::checkError(); }
+        Framebuffer() { glCreateFramebuffers(1, &framebuffer); gl::checkError(); }
+        ~Framebuffer() { glDeleteFramebuffers(1, &framebuffer); gl::checkError(); StateCache::forgetFramebuffer(framebuffer); }
 
         // Disallow copying
         Framebuffer(const Framebuffer&) = delete;
@@ -66,55 +67,62 @@ namespace gl
             glObjectLabel(GL_FRAMEBUFFER, framebuffer, (GLsizei)name.size(), name.data()); gl::checkError();
         }
 
-        void bind() const
-        { 
-            if (lastBoundFramebuffer != framebuffer)
-            {
-                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); gl::checkError();
-                lastBoundFramebuffer = framebuffer;
-            }
-        }
-
-        static void bindDefault()
-        { 
-            if (lastBoundFramebuffer != 0)
-            {
-                glBindFramebuffer(GL_FRAMEBUFFER, 0); gl::checkError();
-                lastBoundFramebuffer = 0;
-            }
-        }
+        void bind() const { StateCache::bindFramebuffer(framebuffer); }
+        static void bindDefault() { StateCache::bindFramebuffer(0); }
 
+        // The attachments are set without binding anything, so they never disturb the draw state
         template <GLenum Target>
         void attach(Attachment attachment, const Texture<Target>& tex, GLint level = 0)
         {
-            bind(); tex.bind();
-            glFramebufferTexture(GL_FRAMEBUFFER, attachment.attachment, tex.texture, level); gl::checkError();
+            glNamedFramebufferTexture(framebuffer, attachment.attachment, tex.texture, level); gl::checkError();
         }
 
         template <GLenum Target>
         void attachLayer(Attachment attachment, const Texture<Target>& tex, GLint level, GLint layer)
         {
-            bind(); tex.bind();
-            glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment.attachment, tex.texture, level, layer); gl::checkError();
+            glNamedFramebufferTextureLayer(framebuffer, attachment.attachment, tex.texture, level, layer); gl::checkError();
         }
 
         void attach(Attachment attachment, const Renderbuffer& rb)
         {
-            bind(); rb.bind();
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment.attachment, GL_RENDERBUFFER, rb.renderbuffer); gl::checkError();
+            glNamedFramebufferRenderbuffer(framebuffer, attachment.attachment, GL_RENDERBUFFER, rb.renderbuffer); gl::checkError();
+        }
+
+        // Copies the first color attachment to the target, or to the default framebuffer if it is null.
+        // It does not go through the bindings, so the state cache is unaffected
+        void blitTo(const Framebuffer* target, GLint width, GLint height) const
+        {
+            glBlitNamedFramebuffer(framebuffer, target ? target->framebuffer : 0, 0, 0, width, height, 0, 0, width, height,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST); gl::checkError();
+        }
+
+        void detach(Attachment attachment)
+        {
+            glNamedFramebufferTexture(framebuffer, attachment.attachment, 0, 0); gl::checkError();
         }
 
         void setDrawBuffers(std::initializer_list<Attachment> attachments)
         {
-            bind();
             // This is sound because they are pointer-interconvertible
-            glDrawBuffers((GLsizei)attachments.size(), reinterpret_cast<const GLenum*>(attachments.begin()));
+            glNamedFramebufferDrawBuffers(framebuffer, (GLsizei)attachments.size(), reinterpret_cast<const GLenum*>(attachments.begin())); gl::checkError();
+        }
+
+        void setDrawBuffers(const std::vector<Attachment>& attachments)
+        {
+            glNamedFramebufferDrawBuffers(framebuffer, (GLsizei)attachments.size(), reinterpret_cast<const GLenum*>(attachments.data())); gl::checkError();
+        }
+
+        // For the framebuffers with only a depth attachment
+        void disableColorBuffers()
+        {
+            glNamedFramebufferDrawBuffer(framebuffer, GL_NONE); gl::checkError();
+            glNamedFramebufferReadBuffer(framebuffer, GL_NONE); gl::checkError();
         }
 
         template <std::same_as<Attachment>... As>
         void setDrawBuffers(As... attachments) { setDrawBuffers({ attachments... }); }
 
-        auto getStatus() const { bind(); return static_cast<FramebufferStatus>(gl::checkError(glCheckFramebufferStatus(GL_FRAMEBUFFER))); }
+        auto getStatus() const { return static_cast<FramebufferStatus>(gl::checkError(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER))); }
     };
 }
 
@@ -0,0 +1,262 @@
+#include "GeometryArena.hpp"
+
+#include "wrappers/glException.hpp"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <numeric>
+
+using namespace gl;
+
+// The same formats as the attributes of gl::Mesh, but all of them are always there
+struct ArenaVertex
+{
+    glm::vec3 position;
+    std::uint32_t normal;
+    glm::u8vec4 color;
+    std::uint16_t shininess, padding;
+};
+
+constexpr std::size_t InitialVertices = 4096;
+constexpr std::size_t InitialIndices = 16384;
+constexpr std::size_t InitialDraws = 64;
+
+bool GeometryArena::RangeAllocator::allocate(std::size_t size, std::size_t& offset)
+{
+    auto it = std::ranges::find_if(freeRanges, [&](const auto& range) { return range.second >= size; });
+    if (it == freeRanges.end()) return false;
+
+    offset = it->first;
+    auto remaining = it->second - size;
+    freeRanges.erase(it);
+    if (remaining > 0) freeRanges.emplace(offset + size, remaining);
+    return true;
+}
+
+void GeometryArena::RangeAllocator::free(std::size_t offset, std::size_t size)
+{
+    if (size == 0) return;
+    auto next = freeRanges.emplace(offset, size).first;
+
+    // Merge with the range after, then with the one before
+    auto after = std::next(next);
+    if (after != freeRanges.end() && next->first + next->second == after->first)
+    {
+        next->second += after->second;
+        freeRanges.erase(after);
+    }
+
+    if (next != freeRanges.begin())
+    {
+        auto before = std::prev(next);
+        if (before->first + before->second == next->first)
+        {
+            before->second += next->second;
+            freeRanges.erase(next);
+        }
+    }
+}
+
+void GeometryArena::RangeAllocator::grow(std::size_t newCapacity)
+{
+    auto oldCapacity = capacity;
+    capacity = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+GeometryArena::GeometryArena() : vertexBuffer(0), indexBuffer(0), drawDataBuffer(0), drawDataCapacity(0), stats()
+{
+    glCreateVertexArrays(1, &vertexArray); gl::checkError();
+
+    growBuffer(vertexBuffer, 0, InitialVertices * sizeof(ArenaVertex));
+    vertices.grow(InitialVertices);
+    growBuffer(indexBuffer, 0, InitialIndices * sizeof(std::uint32_t));
+    indices.grow(InitialIndices);
+    growBuffer(drawDataBuffer, 0, InitialDraws * sizeof(glm::mat4));
+    drawDataCapacity = InitialDraws;
+
+    configureVertexArray();
+}
+
+GeometryArena::~GeometryArena()
+{
+    glDeleteVertexArrays(1, &vertexArray); gl::checkError();
+    StateCache::forgetVertexArray(vertexArray);
+
+    for (auto buffer : { vertexBuffer, indexBuffer, drawDataBuffer })
+    {
+        glDeleteBuffers(1, &buffer); gl::checkError();
+        StateCache::forgetBuffer(buffer);
+    }
+}
+
+void GeometryArena::growBuffer(GLuint& buffer, std::size_t oldSize, std::size_t newSize)
+{
+    GLuint newBuffer;
+    glCreateBuffers(1, &newBuffer); gl::checkError();
+    glNamedBufferStorage(newBuffer, newSize, nullptr, GL_DYNAMIC_STORAGE_BIT); gl::checkError();
+
+    if (buffer == 0) { buffer = newBuffer; return; }
+
+    glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, oldSize); gl::checkError();
+    glDeleteBuffers(1, &buffer); gl::checkError();
+    StateCache::forgetBuffer(buffer);
+    buffer = newBuffer;
+}
+
+std::size_t GeometryArena::allocate(RangeAllocator& allocator, GLuint& buffer, std::size_t size, std::size_t elementSize)
+{
+    std::size_t offset;
+    if (allocator.allocate(size, offset)) return offset;
+
+    // The new space follows the old one, so it merges with a free range at the end
+    auto oldCapacity = allocator.getCapacity();
+    auto newCapacity = std::max(2 * oldCapacity, oldCapacity + size);
+    growBuffer(buffer, oldCapacity * elementSize, newCapacity * elementSize);
+    allocator.grow(newCapacity);
+    allocator.allocate(size, offset);
+
+    configureVertexArray();
+    setBufferNames();
+    return offset;
+}
+
+void GeometryArena::configureVertexArray()
+{
+    // The vertices are on the binding point 0, and the per-draw data on the binding point 1
+    auto configure = [&](GLuint index, GLuint binding, GLint size, GLenum type, bool normalized, std::size_t offset)
+    {
+        glVertexArrayAttribFormat(vertexArray, index, size, type, normalized, (GLuint)offset); gl::checkError();
+        glVertexArrayAttribBinding(vertexArray, index, binding); gl::checkError();
+        glEnableVertexArrayAttrib(vertexArray, index); gl::checkError();
+    };
+
+    glVertexArrayVertexBuffer(vertexArray, 0, vertexBuffer, 0, sizeof(ArenaVertex)); gl::checkError();
+    configure(LayoutIndices::Position, 0, 3, GL_FLOAT, false, offsetof(ArenaVertex, position));
+    configure(LayoutIndices::Normal, 0, 4, GL_INT_2_10_10_10_REV, true, offsetof(ArenaVertex, normal));
+    configure(LayoutIndices::Color, 0, 4, GL_UNSIGNED_BYTE, true, offsetof(ArenaVertex, color));
+    configure(LayoutIndices::Shininess, 0, 1, GL_HALF_FLOAT, false, offsetof(ArenaVertex, shininess));
+    glDisableVertexArrayAttrib(vertexArray, LayoutIndices::Texcoord); gl::checkError();
+
+    // The base instance of each draw picks its model matrix
+    glVertexArrayVertexBuffer(vertexArray, 1, drawDataBuffer, 0, sizeof(glm::mat4)); gl::checkError();
+    glVertexArrayBindingDivisor(vertexArray, 1, 1); gl::checkError();
+    for (GLuint i = 0; i < 4; i++)
+        configure(LayoutIndices::Model0 + i, 1, 4, GL_FLOAT, false, sizeof(glm::vec4) * i);
+
+    glVertexArrayElementBuffer(vertexArray, indexBuffer); gl::checkError();
+}
+
+void GeometryArena::setName(const std::string& name)
+{
+    this->name = name;
+    glObjectLabel(GL_VERTEX_ARRAY, vertexArray, (GLsizei)name.size(), name.data()); gl::checkError();
+    setBufferNames();
+}
+
+void GeometryArena::setBufferNames()
+{
+    if (name.empty()) return;
+
+    auto label = [](GLuint buffer, const std::string& name) { glObjectLabel(GL_BUFFER, buffer, (GLsizei)name.size(), name.data()); gl::checkError(); };
+    label(vertexBuffer, name + " - vertices");
+    label(indexBuffer, name + " - elements");
+    label(drawDataBuffer, name + " - draw data");
+}
+
+GeometryArena::Handle GeometryArena::add(const MeshBuilder& meshBuilder, const glm::mat4& model)
+{
+    auto numVertices = meshBuilder.validateAndGetNumberOfVertices();
+    if (meshBuilder.positions.empty() || !meshBuilder.positionsH.empty() || meshBuilder.normals.empty() || meshBuilder.colors.empty()
+        || meshBuilder.shininesses.empty() || !meshBuilder.texcoords.empty())
+        throw MeshException("The geometry arena only holds meshes with positions, normals, colors and shininesses!");
+
+    std::vector<ArenaVertex> packed(numVertices);
+    for (std::size_t i = 0; i < numVertices; i++)
+        packed[i] = { meshBuilder.positions[i], glm::packSnorm3x10_1x2(glm::vec4(meshBuilder.normals[i], 0)), meshBuilder.colors[i],
+            glm::packHalf1x16(meshBuilder.shininesses[i]), 0 };
+
+    // The draws of the arena always use 32-bit indices, offset by the first vertex of each mesh
+    auto meshIndices = meshBuilder.indices;
+    if (meshIndices.empty())
+    {
+        meshIndices.resize(numVertices);
+        std::iota(meshIndices.begin(), meshIndices.end(), 0);
+    }
+
+    Entry entry{ 0, numVertices, 0, meshIndices.size(), true };
+    entry.firstVertex = allocate(vertices, vertexBuffer, numVertices, sizeof(ArenaVertex));
+    entry.firstIndex = allocate(indices, indexBuffer, meshIndices.size(), sizeof(std::uint32_t));
+
+    glNamedBufferSubData(vertexBuffer, entry.firstVertex * sizeof(ArenaVertex), packed.size() * sizeof(ArenaVertex), packed.data()); gl::checkError();
+    glNamedBufferSubData(indexBuffer, entry.firstIndex * sizeof(std::uint32_t), meshIndices.size() * sizeof(std::uint32_t), meshIndices.data()); gl::checkError();
+
+    // Each mesh keeps its slot of per-draw data for as long as it lives
+    Handle handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        entries[handle] = entry;
+    }
+    else
+    {
+        handle = entries.size();
+        entries.push_back(entry);
+    }
+
+    if (entries.size() > drawDataCapacity)
+    {
+        auto newCapacity = 2 * drawDataCapacity;
+        growBuffer(drawDataBuffer, drawDataCapacity * sizeof(glm::mat4), newCapacity * sizeof(glm::mat4));
+        drawDataCapacity = newCapacity;
+        configureVertexArray();
+        setBufferNames();
+    }
+
+    glNamedBufferSubData(drawDataBuffer, handle * sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(model)); gl::checkError();
+    return handle;
+}
+
+void GeometryArena::remove(Handle handle)
+{
+    auto& entry = entries.at(handle);
+    if (!entry.used) throw MeshException("Removing a mesh which is not in the geometry arena!");
+
+    vertices.free(entry.firstVertex, entry.numVertices);
+    indices.free(entry.firstIndex, entry.numIndices);
+    entry.used = false;
+    freeHandles.push_back(handle);
+}
+
+void GeometryArena::clear()
+{
+    for (Handle handle = 0; handle < entries.size(); handle++)
+        if (entries[handle].used) remove(handle);
+}
+
+void GeometryArena::queue(Handle handle)
+{
+    const auto& entry = entries.at(handle);
+    if (entry.numIndices == 0) return;
+    queued.push_back({ GLuint(entry.numIndices), 1, GLuint(entry.firstIndex), GLint(entry.firstVertex), GLuint(handle) });
+}
+
+void GeometryArena::submit(StreamBuffer& streamBuffer)
+{
+    if (queued.empty()) return;
+
+    auto commands = streamBuffer.upload(queued);
+    StateCache::bindVertexArray(vertexArray);
+    StateCache::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)commands.offset, (GLsizei)queued.size(), 0); gl::checkError();
+
+    stats.submits++;
+    stats.draws += queued.size();
+    queued.clear();
+}
+
+std::size_t GeometryArena::getMemoryUsage() const
+{
+    return vertices.getCapacity() * sizeof(ArenaVertex) + indices.getCapacity() * sizeof(std::uint32_t) + drawDataCapacity * sizeof(glm::mat4);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "Mesh.hpp"
+#include "StreamBuffer.hpp"
+
+namespace gl
+{
+    // Holds many static triangle meshes in a few large buffers with a single vertex array, so the meshes queued
+    // for drawing are submitted together in one glMultiDrawElementsIndirect call. The model matrix of each mesh is
+    // in a buffer of per-draw data, which each draw reads as an instanced attribute starting at its base instance
+    class GeometryArena final
+    {
+    public:
+        using Handle = std::size_t;
+
+        struct Stats
+        {
+            std::size_t submits, draws;
+        };
+
+    private:
+        // The first free range large enough is taken, and freed ranges merge with their neighbors
+        class RangeAllocator final
+        {
+            std::map<std::size_t, std::size_t> freeRanges;
+            std::size_t capacity = 0;
+
+        public:
+            // Returns false if no free range is large enough
+            bool allocate(std::size_t size, std::size_t& offset);
+            void free(std::size_t offset, std::size_t size);
+            void grow(std::size_t newCapacity);
+            std::size_t getCapacity() const { return capacity; }
+        };
+
+        struct Entry
+        {
+            std::size_t firstVertex, numVertices;
+            std::size_t firstIndex, numIndices;
+            bool used;
+        };
+
+        struct DrawCommand
+        {
+            GLuint count, instanceCount, firstIndex;
+            GLint baseVertex;
+            GLuint baseInstance;
+        };
+
+        GLuint vertexArray;
+        GLuint vertexBuffer, indexBuffer, drawDataBuffer;
+        RangeAllocator vertices, indices;
+        std::size_t drawDataCapacity;
+        std::string name;
+        std::vector<Entry> entries;
+        std::vector<Handle> freeHandles;
+        std::vector<DrawCommand> queued;
+        Stats stats;
+
+        // The storage is replaced by a larger one, with the old contents copied over
+        static void growBuffer(GLuint& buffer, std::size_t oldSize, std::size_t newSize);
+        std::size_t allocate(RangeAllocator& allocator, GLuint& buffer, std::size_t size, std::size_t elementSize);
+        void configureVertexArray();
+        void setBufferNames();
+
+    public:
+        GeometryArena();
+        ~GeometryArena();
+
+        // Disallow copying
+        GeometryArena(const GeometryArena&) = delete;
+        GeometryArena& operator=(const GeometryArena&) = delete;
+
+        void setName(const std::string& name);
+
+        // The meshes need positions, normals, colors and shininesses, in the same format as gl::Mesh
+        Handle add(const MeshBuilder& meshBuilder, const glm::mat4& model = glm::mat4(1.0f));
+        void remove(Handle handle);
+        void clear();
+
+        unsigned int getNumElements(Handle handle) const { return (unsigned int)entries.at(handle).numIndices; }
+
+        // The draws are queued, then all drawn by the next submit, whose commands go to the stream buffer
+        void queue(Handle handle);
+        void submit(StreamBuffer& streamBuffer);
+
+        // The submits and the draws since the last reset
+        const Stats& getStats() const { return stats; }
+        void resetStats() { stats = {}; }
+
+        // size of the buffers in GPU memory, in bytes
+        std::size_t getMemoryUsage() const;
+    };
+}
@@ -4,51 +4,109 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <cstddef>
+#include "StateCache.hpp"
+#include "StreamBuffer.hpp"
 #include "wrappers/glException.hpp"
 
 namespace gl
 {
     class InstanceSet final
     {
+    public:
+        // An instance which also carries the parameters of its object
+        struct Instance
+        {
+            glm::mat4 model;
+            glm::u8vec4 color;
+            float shininess;
+        };
+
+    private:
+        // The instances are either in their own buffer, or streamed for a single frame
         GLuint matrixBuffer;
+        GLsizeiptr capacity;
+        GLuint buffer;
+        GLintptr offset;
         GLsizei numInstances;
 
     public:
-        InstanceSet() : numInstances(0) { glGenBuffers(1, &matrixBuffer); gl::checkError(); }
-        ~InstanceSet() { glDeleteBuffers(1, &matrixBuffer); gl::checkError(); }
+        InstanceSet() : matrixBuffer(0), capacity(0), buffer(0), offset(0), numInstances(0)
+        {
+            glCreateBuffers(1, &matrixBuffer); gl::checkError();
+            buffer = matrixBuffer;
+        }
+        ~InstanceSet() { glDeleteBuffers(1, &matrixBuffer); gl::checkError(); StateCache::forgetBuffer(matrixBuffer); }
 
         // Disallow copying
         InstanceSet(const InstanceSet&) = delete;
         InstanceSet& operator=(const InstanceSet&) = delete;
 
         // Enable moving
-        InstanceSet(InstanceSet&& o) noexcept : numInstances(o.numInstances), matrixBuffer(o.matrixBuffer) { o.matrixBuffer = 0; }
+        InstanceSet(InstanceSet&& o) noexcept : matrixBuffer(o.matrixBuffer), capacity(o.capacity), buffer(o.buffer), offset(o.offset),
+            numInstances(o.numInstances) { o.matrixBuffer = 0; o.capacity = 0; o.buffer = 0; }
         InstanceSet& operator=(InstanceSet&& o) noexcept
         {
-            numInstances = o.numInstances;
             std::swap(matrixBuffer, o.matrixBuffer);
+            std::swap(capacity, o.capacity);
+            std::swap(buffer, o.buffer);
+            std::swap(offset, o.offset);
+            std::swap(numInstances, o.numInstances);
             return *this;
         }
 
-        // Upload the instances
-        void setInstances(const std::vector<glm::mat4>& matrices)
+        // Upload the instances along with their color and shininess, which replace the mesh's own
+        // Its storage is immutable, so the buffer is only replaced when it grows
+        void setInstances(const std::vector<Instance>& instances)
+        {
+            auto size = GLsizeiptr(sizeof(Instance) * instances.size());
+            if (size > capacity)
+            {
+                glDeleteBuffers(1, &matrixBuffer); gl::checkError();
+                StateCache::forgetBuffer(matrixBuffer);
+                glCreateBuffers(1, &matrixBuffer); gl::checkError();
+                glNamedBufferStorage(matrixBuffer, size, instances.data(), GL_DYNAMIC_STORAGE_BIT); gl::checkError();
+                capacity = size;
+            }
+            else if (size > 0) { glNamedBufferSubData(matrixBuffer, 0, size, instances.data()); gl::checkError(); }
+
+            buffer = matrixBuffer;
+            offset = 0;
+            numInstances = (GLsizei)instances.size();
+        }
+
+        // Write the instances to the stream buffer instead, where they only last until the end of the frame
+        void streamInstances(StreamBuffer& streamBuffer, const std::vector<Instance>& instances)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, matrixBuffer); gl::checkError();
-            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * matrices.size(), matrices.data(), GL_STREAM_DRAW); gl::checkError();
-            numInstances = (GLsizei)matrices.size();
+            auto allocation = streamBuffer.upload(instances);
+            buffer = allocation.buffer;
+            offset = allocation.offset;
+            numInstances = (GLsizei)instances.size();
         }
 
-        // Use them
-        void useInstances(GLuint modelAttributeIndex) const
+        bool isStreamed() const { return buffer != matrixBuffer; }
+
+        // The streamed instances belong to the stream buffer
+        std::size_t getMemoryUsage() const { return std::size_t(capacity); }
+
+        // Use them, from the binding point 1 of the vertex array
+        void useInstances(GLuint vertexArray, GLuint modelAttributeIndex, GLuint colorAttributeIndex, GLuint shininessAttributeIndex) const
         {
-            glBindBuffer(GL_ARRAY_BUFFER, matrixBuffer); gl::checkError();
+            constexpr GLuint Binding = 1;
+            glVertexArrayVertexBuffer(vertexArray, Binding, buffer, offset, sizeof(Instance)); gl::checkError();
+            glVertexArrayBindingDivisor(vertexArray, Binding, 1); gl::checkError(); // This is what sets it instanced
 
-            for (int i = 0; i < 4; i++)
+            auto configure = [&](GLuint index, GLint size, GLenum type, bool normalized, GLuint relativeOffset)
             {
-                glEnableVertexAttribArray(modelAttributeIndex + i); gl::checkError();
-                glVertexAttribPointer(modelAttributeIndex + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * i)); gl::checkError();
-                glVertexAttribDivisor(modelAttributeIndex + i, 1); gl::checkError(); // This is what sets it instanced
-            }
+                glVertexArrayAttribFormat(vertexArray, index, size, type, normalized, relativeOffset); gl::checkError();
+                glVertexArrayAttribBinding(vertexArray, index, Binding); gl::checkError();
+                glEnableVertexArrayAttrib(vertexArray, index); gl::checkError();
+            };
+
+            for (GLuint i = 0; i < 4; i++)
+                configure(modelAttributeIndex + i, 4, GL_FLOAT, false, GLuint(sizeof(glm::vec4) * i));
+
+            configure(colorAttributeIndex, 4, GL_UNSIGNED_BYTE, true, offsetof(Instance, color));
+            configure(shininessAttributeIndex, 1, GL_FLOAT, false, offsetof(Instance, shininess));
         }
 
         friend class Mesh;
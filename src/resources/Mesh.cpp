@@ -1,80 +1,123 @@
 #include "Mesh.hpp"
 
 #include "wrappers/glException.hpp"
-#include "bufferUtils.hpp"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <algorithm>
 #include <numeric>
-
-namespace LayoutIndices
-{
-    enum : GLuint
-    {
-        Position, Normal, Color, Texcoord, Shininess, Model0, Model1, Model2, Model3
-    };
-}
+#include <iterator>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
 
 using namespace gl;
 
 template <typename T>
-static void concat(std::vector<T>& out, const std::vector<T>& in1, std::size_t expSize1, const std::vector<T>& in2, std::size_t expSize2)
+static void appendAttribute(std::vector<T>& out, std::size_t size1, const std::vector<T>& in, std::size_t size2)
 {
-    if (in1.empty() && in2.empty()) out.clear();
-    else
-    {
-        out.resize(expSize1 + expSize2);
-        auto it = std::copy(in1.begin(), in1.end(), out.begin());
-        std::copy(in2.begin(), in2.end(), out.begin() + expSize1);
-    }
+    if (out.empty() && in.empty()) return;
+
+    // A missing attribute on either side is filled with zeros
+    out.resize(size1);
+    out.insert(out.end(), in.begin(), in.end());
+    out.resize(size1 + size2);
 }
 
 MeshBuilder gl::operator+(const MeshBuilder& mb1, const MeshBuilder& mb2)
 {
-    MeshBuilder mesh;
+    MeshBuilder mesh = mb1;
+    mesh.append(mb2);
+    return mesh;
+}
+
+MeshBuilder& MeshBuilder::append(const MeshBuilder& other)
+{
+    auto size1 = validateAndGetNumberOfVertices();
+    auto size2 = other.validateAndGetNumberOfVertices();
 
-    auto expSize1 = mb1.validateAndGetNumberOfVertices();
-    auto expSize2 = mb2.validateAndGetNumberOfVertices();
+    bool hasHomogeneous1 = positions.empty() && !positionsH.empty();
+    bool hasHomogeneous2 = other.positions.empty() && !other.positionsH.empty();
 
-    bool hasHomogeneous1 = mb1.positions.empty() && !mb1.positionsH.empty();
-    bool hasHomogeneous2 = mb2.positions.empty() && !mb2.positionsH.empty();
+    auto toVec4 = [](const glm::vec3& vec) { return glm::vec4(vec, 1); };
 
     // Convert homogeneous whether necessary
-    if (!hasHomogeneous1 && !hasHomogeneous2)
-        concat(mesh.positions, mb1.positions, expSize1, mb2.positions, expSize2);
-    else if (hasHomogeneous1 && !hasHomogeneous2)
+    if (!hasHomogeneous1 && !hasHomogeneous2) appendAttribute(positions, size1, other.positions, size2);
+    else
     {
-        auto toVec4 = [](const glm::vec3& vec) { return glm::vec4(vec, 1); };
-        std::vector<glm::vec4> homogeneous2(mb2.positions.size());
-        std::transform(mb2.positions.begin(), mb2.positions.end(), homogeneous2.begin(), toVec4);
-        concat(mesh.positionsH, mb1.positionsH, expSize1, homogeneous2, expSize2);
+        if (!hasHomogeneous1)
+        {
+            positionsH.resize(positions.size());
+            std::transform(positions.begin(), positions.end(), positionsH.begin(), toVec4);
+            positions.clear();
+        }
+
+        if (hasHomogeneous2) appendAttribute(positionsH, size1, other.positionsH, size2);
+        else
+        {
+            positionsH.resize(size1);
+            std::transform(other.positions.begin(), other.positions.end(), std::back_inserter(positionsH), toVec4);
+            positionsH.resize(size1 + size2);
+        }
     }
-    else if (!hasHomogeneous1 && hasHomogeneous2)
+
+    // Append the remaining of the attributes
+    appendAttribute(normals, size1, other.normals, size2);
+    appendAttribute(colors, size1, other.colors, size2);
+    appendAttribute(texcoords, size1, other.texcoords, size2);
+    appendAttribute(shininesses, size1, other.shininesses, size2);
+
+    if (!indices.empty() || !other.indices.empty())
     {
-        auto toVec4 = [](const glm::vec3& vec) { return glm::vec4(vec, 1); };
-        std::vector<glm::vec4> homogeneous1(mb1.positions.size());
-        std::transform(mb1.positions.begin(), mb1.positions.end(), homogeneous1.begin(), toVec4);
-        concat(mesh.positionsH, homogeneous1, expSize1, mb2.positionsH, expSize2);
+        // An unindexed mesh is equivalent to the sequence of its vertices
+        if (indices.empty())
+        {
+            indices.resize(size1);
+            std::iota(indices.begin(), indices.end(), 0);
+        }
+
+        auto numElements1 = indices.size();
+        if (other.indices.empty())
+        {
+            indices.resize(numElements1 + size2);
+            std::iota(indices.begin() + numElements1, indices.end(), (std::uint32_t)size1);
+        }
+        else std::transform(other.indices.begin(), other.indices.end(), std::back_inserter(indices),
+            [=](auto idx) { return idx + (std::uint32_t)size1; });
     }
-    else concat(mesh.positionsH, mb1.positionsH, expSize1, mb2.positionsH, expSize2);
 
-    // Concat the remaining of the attributes
-    concat(mesh.normals, mb1.normals, expSize1, mb2.normals, expSize2);
-    concat(mesh.colors, mb1.colors, expSize1, mb2.colors, expSize2);
-    concat(mesh.texcoords, mb1.texcoords, expSize1, mb2.texcoords, expSize2);
-    concat(mesh.shininesses, mb1.shininesses, expSize1, mb2.shininesses, expSize2);
+    return *this;
+}
 
-    if (!mb1.indices.empty() || !mb2.indices.empty())
+MeshBuilder& MeshBuilder::append(std::span<const MeshBuilder> others)
+{
+    // Reserve everything up front, so each attribute is allocated only once
+    auto numVertices = validateAndGetNumberOfVertices();
+    auto numIndices = indices.size();
+    for (const auto& other : others)
     {
-        auto numElements1 = mb1.indices.empty() ? expSize1 : mb1.indices.size();
-        auto numElements2 = mb2.indices.empty() ? expSize2 : mb2.indices.size();
-        concat(mesh.indices, mb1.indices, numElements1, mb2.indices, numElements2);
+        auto otherVertices = other.validateAndGetNumberOfVertices();
+        numVertices += otherVertices;
+        numIndices += other.indices.empty() ? otherVertices : other.indices.size();
+    }
 
-        if (mb1.indices.empty()) std::iota(mesh.indices.begin(), mesh.indices.begin() + numElements1, 0);
+    // Only the attributes which will end up in the mesh need the space
+    auto reserve = [&](auto member, std::size_t size)
+    {
+        bool used = !(this->*member).empty();
+        for (const auto& other : others) used = used || !(other.*member).empty();
+        if (used) (this->*member).reserve(size);
+    };
 
-        if (mb2.indices.empty()) std::iota(mesh.indices.begin() + numElements1, mesh.indices.end(), (unsigned int)expSize1);
-        else std::for_each(mesh.indices.begin() + numElements1, mesh.indices.end(), [=](auto& idx) { idx += (unsigned int)expSize1; });
-    }
+    reserve(&MeshBuilder::positions, numVertices);
+    reserve(&MeshBuilder::positionsH, numVertices);
+    reserve(&MeshBuilder::normals, numVertices);
+    reserve(&MeshBuilder::colors, numVertices);
+    reserve(&MeshBuilder::texcoords, numVertices);
+    reserve(&MeshBuilder::shininesses, numVertices);
+    reserve(&MeshBuilder::indices, numIndices);
 
-    return mesh;
+    for (const auto& other : others) append(other);
+    return *this;
 }
 
 std::size_t MeshBuilder::validateAndGetNumberOfVertices() const
@@ -94,44 +137,152 @@ std::size_t MeshBuilder::validateAndGetNumberOfVertices() const
     return expectedSize;
 }
 
-MeshBuilder& MeshBuilder::operator+=(const MeshBuilder& other)
+GLenum MeshBuilder::getIndexType() const
 {
-    *this = *this + other;
-    return *this;
+    auto maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+    if (maxIndex <= UINT8_MAX) return GL_UNSIGNED_BYTE;
+    if (maxIndex <= UINT16_MAX) return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+// Byte offsets of each attribute inside an interleaved vertex, -1 for absent attributes
+struct VertexLayout
+{
+    GLsizei stride = 0;
+    GLint positionSize = 3;
+    GLint position = -1, normal = -1, color = -1, shininess = -1, texcoord = -1;
+};
+
+static VertexLayout computeLayout(const MeshBuilder& meshBuilder)
+{
+    VertexLayout layout;
+
+    // All attributes are multiple of 4 bytes, so everything stays aligned
+    auto add = [&](GLint& offset, std::size_t size) { offset = layout.stride; layout.stride += (GLsizei)size; };
+
+    if (!meshBuilder.positionsH.empty()) { layout.positionSize = 4; add(layout.position, sizeof(glm::vec4)); }
+    else if (!meshBuilder.positions.empty()) add(layout.position, sizeof(glm::vec3));
+
+    // Normals are quantized to snorm 10_10_10_2
+    if (!meshBuilder.normals.empty()) add(layout.normal, sizeof(std::uint32_t));
+    if (!meshBuilder.colors.empty()) add(layout.color, sizeof(glm::u8vec4));
+
+    // The shininess is stored as a half float right after the color, padded to 4 bytes
+    if (!meshBuilder.shininesses.empty()) add(layout.shininess, 2 * sizeof(std::uint16_t));
+    if (!meshBuilder.texcoords.empty()) add(layout.texcoord, sizeof(glm::vec2));
+
+    return layout;
+}
+
+static std::vector<std::byte> packVertices(const MeshBuilder& meshBuilder, const VertexLayout& layout, std::size_t numVertices)
+{
+    std::vector<std::byte> data(numVertices * layout.stride);
+
+    auto write = [&](GLint offset, const auto& attributes)
+    {
+        if (offset == -1) return;
+        auto out = data.data() + offset;
+        for (const auto& attribute : attributes)
+        {
+            std::memcpy(out, &attribute, sizeof(attribute));
+            out += layout.stride;
+        }
+    };
+
+    auto transform = [](const auto& in, auto func)
+    {
+        std::vector<decltype(func(in[0]))> out(in.size());
+        std::transform(in.begin(), in.end(), out.begin(), func);
+        return out;
+    };
+
+    if (layout.positionSize == 4) write(layout.position, meshBuilder.positionsH);
+    else write(layout.position, meshBuilder.positions);
+    write(layout.normal, transform(meshBuilder.normals, [](const glm::vec3& n) { return glm::packSnorm3x10_1x2(glm::vec4(n, 0)); }));
+    write(layout.color, meshBuilder.colors);
+    write(layout.shininess, transform(meshBuilder.shininesses, [](float s) { return glm::packHalf1x16(s); }));
+    write(layout.texcoord, meshBuilder.texcoords);
+
+    return data;
+}
+
+// The vertices start at base in the buffer, which goes to the binding point 0 of the vertex array
+static void configureLayout(GLuint vertexArray, GLuint buffer, const VertexLayout& layout, GLintptr base = 0)
+{
+    glVertexArrayVertexBuffer(vertexArray, 0, buffer, base, layout.stride); gl::checkError();
+
+    auto configure = [&](GLuint index, GLint offset, GLint size, GLenum type, bool normalized)
+    {
+        if (offset != -1)
+        {
+            glVertexArrayAttribFormat(vertexArray, index, size, type, normalized, offset); gl::checkError();
+            glVertexArrayAttribBinding(vertexArray, index, 0); gl::checkError();
+            glEnableVertexArrayAttrib(vertexArray, index); gl::checkError();
+        }
+        else { glDisableVertexArrayAttrib(vertexArray, index); gl::checkError(); }
+    };
+
+    configure(LayoutIndices::Position, layout.position, layout.positionSize, GL_FLOAT, false);
+    configure(LayoutIndices::Normal, layout.normal, 4, GL_INT_2_10_10_10_REV, true);
+    configure(LayoutIndices::Color, layout.color, 4, GL_UNSIGNED_BYTE, true);
+    configure(LayoutIndices::Shininess, layout.shininess, 1, GL_HALF_FLOAT, false);
+    configure(LayoutIndices::Texcoord, layout.texcoord, 2, GL_FLOAT, false);
+}
+
+// The storage is immutable, and the buffer is never bound to fill it
+template <typename T>
+static GLuint createAndFillBuffer(const std::vector<T>& data)
+{
+    if (data.empty()) return 0;
+    GLuint buffer;
+    glCreateBuffers(1, &buffer); gl::checkError();
+    glNamedBufferStorage(buffer, data.size() * sizeof(T), data.data(), 0); gl::checkError();
+    return buffer;
+}
+
+// Calls func with the indices converted to the given index type
+template <typename F>
+static void withNarrowedIndices(const std::vector<std::uint32_t>& indices, GLenum indexType, F func)
+{
+    auto narrow = [&](auto value)
+    {
+        std::vector<decltype(value)> narrowed(indices.begin(), indices.end());
+        func(narrowed);
+    };
+
+    switch (indexType)
+    {
+        case GL_UNSIGNED_BYTE: narrow(std::uint8_t()); break;
+        case GL_UNSIGNED_SHORT: narrow(std::uint16_t()); break;
+        default: func(indices); break;
+    }
 }
 
 Mesh::Mesh(const MeshBuilder& meshBuilder, PrimitiveType primitiveType) : primitiveType(primitiveType)
 {
     auto numVertices = meshBuilder.validateAndGetNumberOfVertices();
    
-    // Generate the vertex array and bind the necessary indices
-    glGenVertexArrays(1, &vertexArray); gl::checkError(); 
-
-    // And bind the vertex array
-    glBindVertexArray(vertexArray); gl::checkError(); 
-
-    // Generate and configure the attributes
-    if (meshBuilder.positionsH.empty())
-        positionBuffer = createAndConfigureVertexArray(meshBuilder.positions, LayoutIndices::Position);
-    else positionBuffer = createAndConfigureVertexArray(meshBuilder.positionsH, LayoutIndices::Position);
-    normalBuffer = createAndConfigureVertexArray(meshBuilder.normals, LayoutIndices::Normal);
-    colorBuffer = createAndConfigureVertexArray(meshBuilder.colors, LayoutIndices::Color, true);
-    texcoordBuffer = createAndConfigureVertexArray(meshBuilder.texcoords, LayoutIndices::Texcoord);
-    shininessBuffer = createAndConfigureVertexArray(meshBuilder.shininesses, LayoutIndices::Shininess);
-
-    // Build the index list
-    elementBuffer = createAndFillBuffer(meshBuilder.indices, GL_ELEMENT_ARRAY_BUFFER);
+    // Generate the vertex array, which is configured without being bound
+    glCreateVertexArrays(1, &vertexArray); gl::checkError();
+
+    // Pack all the attributes in a single buffer and configure them
+    auto layout = computeLayout(meshBuilder);
+    vertexBuffer = createAndFillBuffer(packVertices(meshBuilder, layout, numVertices));
+    if (vertexBuffer) configureLayout(vertexArray, vertexBuffer, layout);
+
+    // Build the index list with the narrowest type that fits
+    indexType = meshBuilder.getIndexType();
+    withNarrowedIndices(meshBuilder.indices, indexType,
+        [&](const auto& indices) { elementBuffer = createAndFillBuffer(indices); });
     numElements = (unsigned int)(meshBuilder.indices.empty() ? numVertices : meshBuilder.indices.size());
-
-    // Unbind the vertex array
-    glBindVertexArray(0); gl::checkError();
+    if (elementBuffer) { glVertexArrayElementBuffer(vertexArray, elementBuffer); gl::checkError(); }
 }
 
 Mesh Mesh::empty()
 {
     // Create an empty (but valid) mesh
     Mesh mesh;
-    glGenVertexArrays(1, &mesh.vertexArray); gl::checkError();
+    glCreateVertexArrays(1, &mesh.vertexArray); gl::checkError();
     mesh.primitiveType = PrimitiveType::Triangles;
     return mesh;
 }
@@ -141,12 +292,11 @@ Mesh& Mesh::operator=(Mesh&& mesh) noexcept
     std::swap(vertexArray, mesh.vertexArray);
     std::swap(numElements, mesh.numElements);
     std::swap(primitiveType, mesh.primitiveType);
+    std::swap(indexType, mesh.indexType);
     std::swap(elementBuffer, mesh.elementBuffer);
-    std::swap(positionBuffer, mesh.positionBuffer);
-    std::swap(normalBuffer, mesh.normalBuffer);
-    std::swap(colorBuffer, mesh.colorBuffer);
-    std::swap(texcoordBuffer, mesh.texcoordBuffer);
-    std::swap(shininessBuffer, mesh.shininessBuffer);
+    std::swap(vertexBuffer, mesh.vertexBuffer);
+    std::swap(elementOffset, mesh.elementOffset);
+    std::swap(streamed, mesh.streamed);
     return *this;
 }
 
@@ -158,68 +308,68 @@ void Mesh::setBufferName(GLuint buffer, std::string name)
 void Mesh::setName(const std::string& name)
 {
     glObjectLabel(GL_VERTEX_ARRAY, vertexArray, (GLsizei)name.size(), name.data()); gl::checkError();
-    setBufferName(positionBuffer, name + " - position");
-    setBufferName(normalBuffer, name + " - normal");
-    setBufferName(colorBuffer, name + " - color");
-    setBufferName(texcoordBuffer, name + " - texcoord");
-    setBufferName(shininessBuffer, name + " - metalness");
+    if (streamed) return;
+    setBufferName(vertexBuffer, name + " - vertices");
     setBufferName(elementBuffer, name + " - elements");
 }
 
-template <typename T>
-void refillBufferStream(GLuint& buffer, const std::vector<T>& data, GLenum target = GL_ARRAY_BUFFER)
-{
-    if (buffer == 0 && !data.empty())
-    {
-        glGenBuffers(1, &buffer); gl::checkError();
-    }
-    else if (buffer != 0 && data.empty())
-    {
-        glDeleteBuffers(1, &buffer); gl::checkError();
-        buffer = 0;
-    }
-
-    if (data.empty()) return;
-    glBindBuffer(target, buffer); gl::checkError();
-    glBufferData(target, data.size() * sizeof(T), data.data(), GL_STREAM_DRAW); gl::checkError();
-}
-
-template <typename T>
-void reconfigureVertexArrayStream(GLuint& buffer, const std::vector<T>& data, GLuint index, bool normalized = false)
+std::size_t Mesh::getMemoryUsage() const
 {
-    refillBufferStream(buffer, data);
+    // The streamed vertices belong to the stream buffer
+    if (streamed) return 0;
 
-    if (buffer != 0)
+    std::size_t total = 0;
+    for (auto buffer : { vertexBuffer, elementBuffer })
     {
-        glEnableVertexAttribArray(index); gl::checkError();
-        glVertexAttribPointer(index, vector_traits<T>::size, ParamFromType<typename vector_traits<T>::type>, normalized, sizeof(T), nullptr); gl::checkError();
+        if (buffer == 0) continue;
+
+        GLint size;
+        glGetNamedBufferParameteriv(buffer, GL_BUFFER_SIZE, &size); gl::checkError();
+        total += size;
     }
-    else glDisableVertexAttribArray(index); gl::checkError();
+    return total;
 }
 
-void Mesh::streamMesh(const MeshBuilder& meshBuilder, PrimitiveType newPrimitiveType)
+void Mesh::streamMesh(StreamBuffer& streamBuffer, const MeshBuilder& meshBuilder, PrimitiveType newPrimitiveType)
 {
     auto numVertices = meshBuilder.validateAndGetNumberOfVertices();
 
-    // Bind the vertex array
-    glBindVertexArray(vertexArray); gl::checkError();
+    // The buffers of the mesh are not needed anymore
+    if (!streamed)
+    {
+        for (auto buffer : { elementBuffer, vertexBuffer })
+        {
+            glDeleteBuffers(1, &buffer); gl::checkError();
+            StateCache::forgetBuffer(buffer);
+        }
+        streamed = true;
+    }
 
-    // Recreate all buffers
-    if (meshBuilder.positionsH.empty())
-        reconfigureVertexArrayStream(positionBuffer, meshBuilder.positions, LayoutIndices::Position);
-    else reconfigureVertexArrayStream(positionBuffer, meshBuilder.positionsH, LayoutIndices::Position);
-    reconfigureVertexArrayStream(normalBuffer, meshBuilder.normals, LayoutIndices::Normal);
-    reconfigureVertexArrayStream(colorBuffer, meshBuilder.colors, LayoutIndices::Color, true);
-    reconfigureVertexArrayStream(texcoordBuffer, meshBuilder.texcoords, LayoutIndices::Texcoord);
-    reconfigureVertexArrayStream(texcoordBuffer, meshBuilder.shininesses, LayoutIndices::Shininess);
+    // Repack the vertices, the layout might have changed
+    auto layout = computeLayout(meshBuilder);
+    auto vertices = packVertices(meshBuilder, layout, numVertices);
+    vertexBuffer = 0;
+    if (!vertices.empty())
+    {
+        auto allocation = streamBuffer.upload(vertices);
+        vertexBuffer = allocation.buffer;
+        configureLayout(vertexArray, vertexBuffer, layout, allocation.offset);
+    }
 
     // Rebuild the index list
-    refillBufferStream(elementBuffer, meshBuilder.indices, GL_ELEMENT_ARRAY_BUFFER);
+    indexType = meshBuilder.getIndexType();
+    elementBuffer = 0;
+    elementOffset = 0;
+    if (!meshBuilder.indices.empty())
+        withNarrowedIndices(meshBuilder.indices, indexType, [&](const auto& indices)
+        {
+            auto allocation = streamBuffer.upload(indices);
+            elementBuffer = allocation.buffer;
+            elementOffset = allocation.offset;
+        });
+    glVertexArrayElementBuffer(vertexArray, elementBuffer); gl::checkError();
     numElements = (unsigned int)(meshBuilder.indices.empty() ? numVertices : meshBuilder.indices.size());
     primitiveType = newPrimitiveType;
-
-    // Unbind it in order to avoid outside changes
-    glBindVertexArray(0); gl::checkError();
 }
 
 void Mesh::draw(const glm::mat4& model) const
@@ -227,7 +377,7 @@ void Mesh::draw(const glm::mat4& model) const
     if (numElements == 0) return;
 
     // Bind the vertex array
-    glBindVertexArray(vertexArray); gl::checkError();
+    StateCache::bindVertexArray(vertexArray);
 
     // Bind the vertex attribute
     glVertexAttrib4fv(LayoutIndices::Model0, glm::value_ptr(model[0])); gl::checkError();
@@ -237,7 +387,7 @@ void Mesh::draw(const glm::mat4& model) const
 
     // Use the appropriate draw function
     auto mode = static_cast<GLenum>(primitiveType);
-    if (elementBuffer) { glDrawElements(mode, numElements, GL_UNSIGNED_SHORT, nullptr); gl::checkError(); }
+    if (elementBuffer) { glDrawElements(mode, numElements, indexType, (const void*)elementOffset); gl::checkError(); }
     else { glDrawArrays(mode, 0, numElements); gl::checkError(); }
 }
 
@@ -246,14 +396,14 @@ void Mesh::draw(const InstanceSet& instances) const
     if (numElements == 0) return;
 
     // Bind the vertex array
-    glBindVertexArray(vertexArray); gl::checkError();
+    StateCache::bindVertexArray(vertexArray);
 
     // Bind the vertex attribute
-    instances.useInstances(LayoutIndices::Model0);
+    instances.useInstances(vertexArray, LayoutIndices::Model0, LayoutIndices::Color, LayoutIndices::Shininess);
 
     // Use the appropriate draw function
     auto mode = static_cast<GLenum>(primitiveType);
-    if (elementBuffer) { glDrawElementsInstanced(mode, numElements, GL_UNSIGNED_SHORT, nullptr, instances.numInstances); gl::checkError(); }
+    if (elementBuffer) { glDrawElementsInstanced(mode, numElements, indexType, (const void*)elementOffset, instances.numInstances); gl::checkError(); }
     else { glDrawArraysInstanced(mode, 0, numElements, instances.numInstances); gl::checkError(); }
 }
 
@@ -262,11 +412,12 @@ Mesh::~Mesh()
 {
     // Delete the vertex array
     glDeleteVertexArrays(1, &vertexArray); gl::checkError();
+    StateCache::forgetVertexArray(vertexArray);
 
-    glDeleteBuffers(1, &elementBuffer); gl::checkError();
-    glDeleteBuffers(1, &positionBuffer); gl::checkError();
-    glDeleteBuffers(1, &normalBuffer); gl::checkError();
-    glDeleteBuffers(1, &colorBuffer); gl::checkError();
-    glDeleteBuffers(1, &texcoordBuffer); gl::checkError();
-    glDeleteBuffers(1, &shininessBuffer); gl::checkError();
+    if (streamed) return;
+    for (auto buffer : { elementBuffer, vertexBuffer })
+    {
+        glDeleteBuffers(1, &buffer); gl::checkError();
+        StateCache::forgetBuffer(buffer);
+    }
 }
@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <span>
+#include <cstdint>
 #include <stdexcept>
 #include "InstanceSet.hpp"
 
@@ -19,6 +21,15 @@ namespace gl
         TriangleFan = GL_TRIANGLE_FAN
     };
 
+    // The attribute locations of the vertex shaders, see vertexDefs.glsl
+    namespace LayoutIndices
+    {
+        enum : GLuint
+        {
+            Position, Normal, Color, Texcoord, Shininess, Model0, Model1, Model2, Model3
+        };
+    }
+
     // The MeshBuilder is the structure that we'll feed to the Mesh constructor to actually build it
     struct MeshBuilder final
     {
@@ -28,11 +39,18 @@ namespace gl
         std::vector<glm::u8vec4> colors;
         std::vector<glm::vec2> texcoords;
         std::vector<float> shininesses;
-        std::vector<unsigned short> indices;
+        // Indices are always built with 32 bits, the mesh narrows them down when uploading
+        std::vector<std::uint32_t> indices;
 
         std::size_t validateAndGetNumberOfVertices() const;
 
-        MeshBuilder& operator+=(const MeshBuilder& other);
+        // The smallest index type which can address every vertex referenced by the indices
+        GLenum getIndexType() const;
+
+        // Appending works in place, so building a mesh piece by piece is linear in its size
+        MeshBuilder& append(const MeshBuilder& other);
+        MeshBuilder& append(std::span<const MeshBuilder> others);
+        MeshBuilder& operator+=(const MeshBuilder& other) { return append(other); }
     };
 
     MeshBuilder operator+(const MeshBuilder& mb1, const MeshBuilder& mb2);
@@ -49,15 +67,20 @@ namespace gl
         GLuint vertexArray;
         unsigned int numElements;
         PrimitiveType primitiveType;
+        GLenum indexType;
 
-        GLuint elementBuffer;
-        GLuint positionBuffer, normalBuffer, colorBuffer, texcoordBuffer, shininessBuffer;
+        // All the attributes are interleaved in a single buffer
+        GLuint elementBuffer, vertexBuffer;
+
+        // A streamed mesh is in the stream buffer instead, which owns the buffer
+        GLintptr elementOffset;
+        bool streamed;
 
         void setBufferName(GLuint buffer, std::string name);
 
     public:
-        Mesh() noexcept : vertexArray(0), numElements(0), elementBuffer(0), positionBuffer(0), normalBuffer(0),
-            colorBuffer(0), texcoordBuffer(0), shininessBuffer(0), primitiveType(PrimitiveType::Triangles) {}
+        Mesh() noexcept : vertexArray(0), numElements(0), primitiveType(PrimitiveType::Triangles), indexType(GL_UNSIGNED_SHORT),
+            elementBuffer(0), vertexBuffer(0), elementOffset(0), streamed(false) {}
         Mesh(const MeshBuilder& meshBuilder, PrimitiveType primitiveType = PrimitiveType::Triangles);
 
         static Mesh empty();
@@ -71,8 +94,13 @@ namespace gl
 
         void setName(const std::string& name);
 
-        // reupload the data
-        void streamMesh(const MeshBuilder& meshBuilder, PrimitiveType newPrimitiveType = PrimitiveType::Triangles);
+        // write the data to the stream buffer, where it lasts until the end of the frame
+        void streamMesh(StreamBuffer& streamBuffer, const MeshBuilder& meshBuilder, PrimitiveType newPrimitiveType = PrimitiveType::Triangles);
+
+        unsigned int getNumElements() const { return numElements; }
+
+        // size of the buffers in GPU memory, in bytes
+        std::size_t getMemoryUsage() const;
 
         // draw the mesh
         void draw(const glm::mat4& modelMatrix) const;
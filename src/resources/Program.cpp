@@ -5,25 +5,73 @@
 
 using namespace gl;
 
-thread_local GLuint Program::lastUsedProgram = 0;
-
 void Program::relink()
 {
     glLinkProgram(program); gl::checkError();
     GLint status;
     glGetProgramiv(program, GL_LINK_STATUS, &status); gl::checkError();
     if (!status) throw ProgramException("Failed to link program: " + getInfoLog());
+
+    reflectUniforms();
 }
 
-void Program::use() const
+void Program::reflectUniforms()
 {
-    if (lastUsedProgram != program)
+    uniformLocations.clear();
+
+    GLint numUniforms, maxNameLength;
+    glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms); gl::checkError();
+    glGetProgramInterfaceiv(program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength); gl::checkError();
+
+    std::string name(maxNameLength, 0);
+    auto addLocation = [&](std::string_view name, GLint location)
+    {
+        auto [it, inserted] = uniformLocations.emplace(util::stringHash(name), location);
+        if (!inserted && it->second != location)
+            throw ProgramException("Hash collision between uniform names in program: " + std::string(name));
+    };
+
+    for (GLint i = 0; i < numUniforms; i++)
     {
-        glUseProgram(program); gl::checkError();
-        lastUsedProgram = program;
+        const GLenum props[] = { GL_LOCATION, GL_ARRAY_SIZE };
+        GLint values[2];
+        glGetProgramResourceiv(program, GL_UNIFORM, i, 2, props, 2, nullptr, values); gl::checkError();
+
+        // Uniforms inside blocks have no location
+        if (values[0] == -1) continue;
+
+        GLsizei length;
+        glGetProgramResourceName(program, GL_UNIFORM, i, maxNameLength, &length, name.data()); gl::checkError();
+        auto namev = std::string_view(name.data(), length);
+        addLocation(namev, values[0]);
+
+        // Arrays are reported as "name[0]", but they can also be referred by "name" or by any other element
+        if (namev.ends_with("[0]"))
+        {
+            auto base = std::string(namev.substr(0, namev.size() - 3));
+            addLocation(base, values[0]);
+
+            for (GLint j = 1; j < values[1]; j++)
+            {
+                auto element = base + '[' + std::to_string(j) + ']';
+                addLocation(element, gl::checkError(glGetUniformLocation(program, element.c_str())));
+            }
+        }
     }
 }
 
+GLint Program::getUniformLocation(UniformName name) const
+{
+    // Behave like glGetUniformLocation for names which are not active uniforms
+    auto it = uniformLocations.find(name.getHash());
+    return it == uniformLocations.end() ? -1 : it->second;
+}
+
+void Program::use() const
+{
+    StateCache::useProgram(program);
+}
+
 bool Program::isValid() const
 {
     glValidateProgram(program); gl::checkError();
@@ -51,244 +99,244 @@ Program::~Program()
     glDeleteProgram(program); gl::checkError();
 }
 
-void Program::setUniform(const char* name, float value)
+void Program::setUniform(UniformName name, float value)
 {
-    use(); glUniform1f(getUniformLocation(name), value); gl::checkError();
+    glProgramUniform1f(program, getUniformLocation(name), value); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::vec1& value)
+void Program::setUniform(UniformName name, const glm::vec1& value)
 {
-    use(); glUniform1f(getUniformLocation(name), value.x); gl::checkError();
+    glProgramUniform1f(program, getUniformLocation(name), value.x); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::vec2& value)
+void Program::setUniform(UniformName name, const glm::vec2& value)
 {
-    use(); glUniform2fv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform2fv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::vec3& value)
+void Program::setUniform(UniformName name, const glm::vec3& value)
 {
-    use(); glUniform3fv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform3fv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::vec4& value)
+void Program::setUniform(UniformName name, const glm::vec4& value)
 {
-    use(); glUniform4fv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform4fv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, int value)
+void Program::setUniform(UniformName name, int value)
 {
-    use(); glUniform1i(getUniformLocation(name), value); gl::checkError();
+    glProgramUniform1i(program, getUniformLocation(name), value); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::ivec1& value)
+void Program::setUniform(UniformName name, const glm::ivec1& value)
 {
-    use(); glUniform1i(getUniformLocation(name), value.x); gl::checkError();
+    glProgramUniform1i(program, getUniformLocation(name), value.x); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::ivec2& value)
+void Program::setUniform(UniformName name, const glm::ivec2& value)
 {
-    use(); glUniform2iv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform2iv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::ivec3& value)
+void Program::setUniform(UniformName name, const glm::ivec3& value)
 {
-    use(); glUniform3iv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform3iv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::ivec4& value)
+void Program::setUniform(UniformName name, const glm::ivec4& value)
 {
-    use(); glUniform4iv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform4iv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, unsigned int value)
+void Program::setUniform(UniformName name, unsigned int value)
 {
-    use(); glUniform1ui(getUniformLocation(name), value); gl::checkError();
+    glProgramUniform1ui(program, getUniformLocation(name), value); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::uvec1& value)
+void Program::setUniform(UniformName name, const glm::uvec1& value)
 {
-    use(); glUniform1ui(getUniformLocation(name), value.x); gl::checkError();
+    glProgramUniform1ui(program, getUniformLocation(name), value.x); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::uvec2& value)
+void Program::setUniform(UniformName name, const glm::uvec2& value)
 {
-    use(); glUniform2uiv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform2uiv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::uvec3& value)
+void Program::setUniform(UniformName name, const glm::uvec3& value)
 {
-    use(); glUniform3uiv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform3uiv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::uvec4& value)
+void Program::setUniform(UniformName name, const glm::uvec4& value)
 {
-    use(); glUniform4uiv(getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
+    glProgramUniform4uiv(program, getUniformLocation(name), 1, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat2& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat2& value, bool transpose)
 {
-    use(); glUniformMatrix2fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix2fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat3& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat3& value, bool transpose)
 {
-    use(); glUniformMatrix3fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix3fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat4& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat4& value, bool transpose)
 {
-    use(); glUniformMatrix4fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix4fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat2x3& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat2x3& value, bool transpose)
 {
-    use(); glUniformMatrix2x3fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix2x3fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat3x2& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat3x2& value, bool transpose)
 {
-    use(); glUniformMatrix3x2fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix3x2fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat2x4& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat2x4& value, bool transpose)
 {
-    use(); glUniformMatrix2x4fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix2x4fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat4x2& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat4x2& value, bool transpose)
 {
-    use(); glUniformMatrix4x2fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix4x2fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat3x4& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat3x4& value, bool transpose)
 {
-    use(); glUniformMatrix3x4fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix3x4fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const glm::mat4x3& value, bool transpose)
+void Program::setUniform(UniformName name, const glm::mat4x3& value, bool transpose)
 {
-    use(); glUniformMatrix4x3fv(getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
+    glProgramUniformMatrix4x3fv(program, getUniformLocation(name), 1, transpose, glm::value_ptr(value)); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<float>& value)
+void Program::setUniform(UniformName name, const std::vector<float>& value)
 {
-    use(); glUniform1fv(getUniformLocation(name), (GLsizei)value.size(), value.data()); gl::checkError();
+    glProgramUniform1fv(program, getUniformLocation(name), (GLsizei)value.size(), value.data()); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::vec1>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::vec1>& value)
 {
-    use(); glUniform1fv(getUniformLocation(name), (GLsizei)value.size(), &value[0].x); gl::checkError();
+    glProgramUniform1fv(program, getUniformLocation(name), (GLsizei)value.size(), &value[0].x); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::vec2>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::vec2>& value)
 {
-    use(); glUniform2fv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform2fv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::vec3>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::vec3>& value)
 {
-    use(); glUniform3fv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform3fv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::vec4>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::vec4>& value)
 {
-    use(); glUniform4fv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform4fv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<int>& value)
+void Program::setUniform(UniformName name, const std::vector<int>& value)
 {
-    use(); glUniform1iv(getUniformLocation(name), (GLsizei)value.size(), value.data()); gl::checkError();
+    glProgramUniform1iv(program, getUniformLocation(name), (GLsizei)value.size(), value.data()); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::ivec1>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::ivec1>& value)
 {
-    use(); glUniform1iv(getUniformLocation(name), (GLsizei)value.size(), &value[0].x); gl::checkError();
+    glProgramUniform1iv(program, getUniformLocation(name), (GLsizei)value.size(), &value[0].x); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::ivec2>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::ivec2>& value)
 {
-    use(); glUniform2iv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform2iv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::ivec3>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::ivec3>& value)
 {
-    use(); glUniform3iv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform3iv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::ivec4>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::ivec4>& value)
 {
-    use(); glUniform4iv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform4iv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<unsigned int>& value)
+void Program::setUniform(UniformName name, const std::vector<unsigned int>& value)
 {
-    use(); glUniform1uiv(getUniformLocation(name), (GLsizei)value.size(), value.data()); gl::checkError();
+    glProgramUniform1uiv(program, getUniformLocation(name), (GLsizei)value.size(), value.data()); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::uvec1>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::uvec1>& value)
 {
-    use(); glUniform1uiv(getUniformLocation(name), (GLsizei)value.size(), &value[0].x); gl::checkError();
+    glProgramUniform1uiv(program, getUniformLocation(name), (GLsizei)value.size(), &value[0].x); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::uvec2>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::uvec2>& value)
 {
-    use(); glUniform2uiv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform2uiv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::uvec3>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::uvec3>& value)
 {
-    use(); glUniform3uiv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform3uiv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::uvec4>& value)
+void Program::setUniform(UniformName name, const std::vector<glm::uvec4>& value)
 {
-    use(); glUniform4uiv(getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniform4uiv(program, getUniformLocation(name), (GLsizei)value.size(), glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat2>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat2>& value, bool transpose)
 {
-    use(); glUniformMatrix2fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix2fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat3>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat3>& value, bool transpose)
 {
-    use(); glUniformMatrix3fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix3fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat4>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat4>& value, bool transpose)
 {
-    use(); glUniformMatrix4fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix4fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat2x3>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat2x3>& value, bool transpose)
 {
-    use(); glUniformMatrix2x3fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix2x3fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat3x2>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat3x2>& value, bool transpose)
 {
-    use(); glUniformMatrix3x2fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix3x2fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat2x4>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat2x4>& value, bool transpose)
 {
-    use(); glUniformMatrix2x4fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix2x4fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat4x2>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat4x2>& value, bool transpose)
 {
-    use(); glUniformMatrix4x2fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix4x2fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat3x4>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat3x4>& value, bool transpose)
 {
-    use(); glUniformMatrix3x4fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix3x4fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
-void Program::setUniform(const char* name, const std::vector<glm::mat4x3>& value, bool transpose)
+void Program::setUniform(UniformName name, const std::vector<glm::mat4x3>& value, bool transpose)
 {
-    use(); glUniformMatrix4x3fv(getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
+    glProgramUniformMatrix4x3fv(program, getUniformLocation(name), (GLsizei)value.size(), transpose, glm::value_ptr(value[0])); gl::checkError();
 }
 
 void gl::Program::bindUniformBlock(const char* name, int index)
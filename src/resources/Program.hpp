@@ -6,7 +6,11 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <memory>
+#include <string_view>
+#include <unordered_map>
 #include "Shader.hpp"
+#include "util/stringHash.hpp"
+#include "StateCache.hpp"
 #include "wrappers/glException.hpp"
 
 namespace gl
@@ -17,12 +21,29 @@ namespace gl
         ProgramException(std::string what) : std::runtime_error(what) {}
     };
 
+    // The name of an uniform, hashed at compile time when it comes from a string literal
+    class UniformName final
+    {
+        std::uint64_t hash;
+
+    public:
+        template <std::size_t N>
+        consteval UniformName(const char (&name)[N]) : hash(util::stringHash(std::string_view(name, N - 1))) {}
+        explicit UniformName(std::string_view name) : hash(util::stringHash(name)) {}
+
+        auto getHash() const { return hash; }
+    };
+
     class Program
     {
-        static thread_local GLuint lastUsedProgram;
+        // The hashes are already computed, so there is no need to hash them again
+        struct IdentityHash { std::size_t operator()(std::uint64_t hash) const { return (std::size_t)hash; } };
+
         GLuint program;
+        std::unordered_map<std::uint64_t, GLint, IdentityHash> uniformLocations;
 
         void relink();
+        void reflectUniforms();
 
     public:
         Program() : program(0) {}
@@ -50,10 +71,11 @@ namespace gl
         Program& operator=(const Program&) = delete;
 
         // Enable moving
-        Program(Program&& o) noexcept : program(o.program) { o.program = 0; }
+        Program(Program&& o) noexcept : program(o.program), uniformLocations(std::move(o.uniformLocations)) { o.program = 0; }
         Program& operator=(Program&& o) noexcept
         {
             std::swap(program, o.program);
+            std::swap(uniformLocations, o.uniformLocations);
             return *this;
         }
 
@@ -65,60 +87,60 @@ namespace gl
 
         // Attribute and uniform data
         auto getAttributeLocation(const char* name) const { return gl::checkError(glGetAttribLocation(program, name)); }
-        auto getUniformLocation(const char* name) const { return gl::checkError(glGetUniformLocation(program, name)); }
+        GLint getUniformLocation(UniformName name) const;
         auto getUniformBlockIndex(const char* name) const { return gl::checkError(glGetUniformBlockIndex(program, name)); }
 
-        // All uniform setting functons
-        void setUniform(const char* name, float value);
-        void setUniform(const char* name, const glm::vec1& value);
-        void setUniform(const char* name, const glm::vec2& value);
-        void setUniform(const char* name, const glm::vec3& value);
-        void setUniform(const char* name, const glm::vec4& value);
-        void setUniform(const char* name, int value);
-        void setUniform(const char* name, const glm::ivec1& value);
-        void setUniform(const char* name, const glm::ivec2& value);
-        void setUniform(const char* name, const glm::ivec3& value);
-        void setUniform(const char* name, const glm::ivec4& value);
-        void setUniform(const char* name, unsigned int value);
-        void setUniform(const char* name, const glm::uvec1& value);
-        void setUniform(const char* name, const glm::uvec2& value);
-        void setUniform(const char* name, const glm::uvec3& value);
-        void setUniform(const char* name, const glm::uvec4& value);
-        void setUniform(const char* name, const glm::mat2& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat3& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat4& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat2x3& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat3x2& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat2x4& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat4x2& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat3x4& value, bool transpose = false);
-        void setUniform(const char* name, const glm::mat4x3& value, bool transpose = false);
+        // All uniform setting functons, which go straight to the program without making it current
+        void setUniform(UniformName name, float value);
+        void setUniform(UniformName name, const glm::vec1& value);
+        void setUniform(UniformName name, const glm::vec2& value);
+        void setUniform(UniformName name, const glm::vec3& value);
+        void setUniform(UniformName name, const glm::vec4& value);
+        void setUniform(UniformName name, int value);
+        void setUniform(UniformName name, const glm::ivec1& value);
+        void setUniform(UniformName name, const glm::ivec2& value);
+        void setUniform(UniformName name, const glm::ivec3& value);
+        void setUniform(UniformName name, const glm::ivec4& value);
+        void setUniform(UniformName name, unsigned int value);
+        void setUniform(UniformName name, const glm::uvec1& value);
+        void setUniform(UniformName name, const glm::uvec2& value);
+        void setUniform(UniformName name, const glm::uvec3& value);
+        void setUniform(UniformName name, const glm::uvec4& value);
+        void setUniform(UniformName name, const glm::mat2& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat3& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat4& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat2x3& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat3x2& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat2x4& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat4x2& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat3x4& value, bool transpose = false);
+        void setUniform(UniformName name, const glm::mat4x3& value, bool transpose = false);
 
         // Vector uniform setting functions
-        void setUniform(const char* name, const std::vector<float>& value);
-        void setUniform(const char* name, const std::vector<glm::vec1>& value);
-        void setUniform(const char* name, const std::vector<glm::vec2>& value);
-        void setUniform(const char* name, const std::vector<glm::vec3>& value);
-        void setUniform(const char* name, const std::vector<glm::vec4>& value);
-        void setUniform(const char* name, const std::vector<int>& value);
-        void setUniform(const char* name, const std::vector<glm::ivec1>& value);
-        void setUniform(const char* name, const std::vector<glm::ivec2>& value);
-        void setUniform(const char* name, const std::vector<glm::ivec3>& value);
-        void setUniform(const char* name, const std::vector<glm::ivec4>& value);
-        void setUniform(const char* name, const std::vector<unsigned int>& value);
-        void setUniform(const char* name, const std::vector<glm::uvec1>& value);
-        void setUniform(const char* name, const std::vector<glm::uvec2>& value);
-        void setUniform(const char* name, const std::vector<glm::uvec3>& value);
-        void setUniform(const char* name, const std::vector<glm::uvec4>& value);
-        void setUniform(const char* name, const std::vector<glm::mat2>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat3>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat4>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat2x3>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat3x2>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat2x4>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat4x2>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat3x4>& value, bool transpose = false);
-        void setUniform(const char* name, const std::vector<glm::mat4x3>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<float>& value);
+        void setUniform(UniformName name, const std::vector<glm::vec1>& value);
+        void setUniform(UniformName name, const std::vector<glm::vec2>& value);
+        void setUniform(UniformName name, const std::vector<glm::vec3>& value);
+        void setUniform(UniformName name, const std::vector<glm::vec4>& value);
+        void setUniform(UniformName name, const std::vector<int>& value);
+        void setUniform(UniformName name, const std::vector<glm::ivec1>& value);
+        void setUniform(UniformName name, const std::vector<glm::ivec2>& value);
+        void setUniform(UniformName name, const std::vector<glm::ivec3>& value);
+        void setUniform(UniformName name, const std::vector<glm::ivec4>& value);
+        void setUniform(UniformName name, const std::vector<unsigned int>& value);
+        void setUniform(UniformName name, const std::vector<glm::uvec1>& value);
+        void setUniform(UniformName name, const std::vector<glm::uvec2>& value);
+        void setUniform(UniformName name, const std::vector<glm::uvec3>& value);
+        void setUniform(UniformName name, const std::vector<glm::uvec4>& value);
+        void setUniform(UniformName name, const std::vector<glm::mat2>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat3>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat4>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat2x3>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat3x2>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat2x4>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat4x2>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat3x4>& value, bool transpose = false);
+        void setUniform(UniformName name, const std::vector<glm::mat4x3>& value, bool transpose = false);
 
         void bindUniformBlock(const char* name, int index);
 
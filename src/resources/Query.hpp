@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 #include <algorithm>
 #include <string>
+#include "wrappers/glException.hpp"
 
 namespace gl
 {
@@ -12,7 +13,8 @@ namespace gl
         AnySamplesPassed = GL_ANY_SAMPLES_PASSED,
         PrimitivesGenerated = GL_PRIMITIVES_GENERATED,
         TransformFeedbackPrimitivesWritten = GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN,
-        TimeElapsed = GL_TIME_ELAPSED
+        TimeElapsed = GL_TIME_ELAPSED,
+        Timestamp = GL_TIMESTAMP
     };
 
     class Query final
@@ -21,7 +23,7 @@ namespace gl
         QueryType type;
 
     public:
-        Query(QueryType type) : type(type) { glGenQueries(1, &query); gl::checkError(); }
+        Query(QueryType type) : type(type) { glCreateQueries(static_cast<GLenum>(type), 1, &query); gl::checkError(); }
         ~Query() { glDeleteQueries(1, &query); gl::checkError(); }
 
         // Disallow copying
@@ -45,6 +47,9 @@ namespace gl
         void begin() const { glBeginQuery(static_cast<GLenum>(type), query); gl::checkError(); }
         void end() const { glEndQuery(static_cast<GLenum>(type)); gl::checkError(); }
 
+        // Only for timestamps, which are written once the commands before are done instead of spanning a range
+        void queryCounter() const { glQueryCounter(query, GL_TIMESTAMP); gl::checkError(); }
+
         bool available() const
         {
             GLint param;
@@ -3,17 +3,17 @@
 #include <glad/glad.h>
 #include <algorithm>
 #include "TextureFormats.hpp"
+#include "StateCache.hpp"
 
 namespace gl
 {
     class Renderbuffer final
     {
         GLuint renderbuffer;
-        static inline GLuint lastBoundRenderbuffer = 0;
 
     public:
-        Renderbuffer() { glGenRenderbuffers(1, &renderbuffer); gl::checkError(); }
-        ~Renderbuffer() { glDeleteRenderbuffers(1, &renderbuffer); gl::checkError(); }
+        Renderbuffer() { glCreateRenderbuffers(1, &renderbuffer); gl::checkError(); }
+        ~Renderbuffer() { glDeleteRenderbuffers(1, &renderbuffer); gl::checkError(); StateCache::forgetRenderbuffer(renderbuffer); }
 
         // Disallow copying
         Renderbuffer(const Renderbuffer&) = delete;
@@ -32,19 +32,11 @@ namespace gl
             glObjectLabel(GL_RENDERBUFFER, renderbuffer, (GLsizei)name.size(), name.data()); gl::checkError();
         }
 
-        void bind() const 
-        { 
-            if (lastBoundRenderbuffer != renderbuffer)
-            {
-                glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer); gl::checkError();
-                lastBoundRenderbuffer = renderbuffer;
-            }
-        }
+        void bind() const { StateCache::bindRenderbuffer(renderbuffer); }
 
         void storage(gl::InternalFormat format, GLsizei width, GLsizei height)
         {
-            bind();
-            glRenderbufferStorage(GL_RENDERBUFFER, static_cast<GLenum>(format), width, height); gl::checkError();
+            glNamedRenderbufferStorage(renderbuffer, static_cast<GLenum>(format), width, height); gl::checkError();
         }
 
         friend class Framebuffer;
@@ -11,6 +11,7 @@ auto shaderTypeToString(ShaderType type)
     case ShaderType::VertexShader: return "vertex";
     case ShaderType::GeometryShader: return "geometry";
     case ShaderType::FragmentShader: return "fragment";
+    case ShaderType::ComputeShader: return "compute";
     }
     return "";
 }
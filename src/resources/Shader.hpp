@@ -12,7 +12,8 @@ namespace gl
         Unknown = 0,
         VertexShader = GL_VERTEX_SHADER,
         GeometryShader = GL_GEOMETRY_SHADER,
-        FragmentShader = GL_FRAGMENT_SHADER
+        FragmentShader = GL_FRAGMENT_SHADER,
+        ComputeShader = GL_COMPUTE_SHADER
     };
 
     class ShaderException : public std::runtime_error
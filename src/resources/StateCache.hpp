@@ -0,0 +1,170 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "wrappers/glException.hpp"
+
+namespace gl
+{
+    struct StateCounters
+    {
+        std::size_t issued = 0, elided = 0;
+    };
+
+    // Shadows the OpenGL binding state of the current thread's context, so all the wrappers
+    // can skip state changes which would not change anything. Everything that changes bindings
+    // must go through here, otherwise the cache goes out of sync with the driver.
+    class StateCache final
+    {
+        struct State
+        {
+            GLuint program = 0;
+            GLuint framebuffer = 0;
+            GLuint renderbuffer = 0;
+            GLuint vertexArray = 0;
+            GLuint activeTexture = 0;
+            glm::ivec4 viewport = glm::ivec4(-1);
+            std::unordered_map<std::uint64_t, GLuint> textures;
+            std::unordered_map<GLenum, GLuint> buffers;
+            std::unordered_map<std::uint64_t, GLuint> indexedBuffers;
+            std::unordered_map<GLenum, bool> capabilities;
+        };
+
+        static thread_local State state;
+        static inline thread_local StateCounters counters;
+
+        // Never the name of a buffer, so it never matches the one being bound
+        static constexpr GLuint UnknownBuffer = ~GLuint(0);
+
+        static std::uint64_t key(GLuint index, GLenum target) { return (std::uint64_t(index) << 32) | target; }
+
+        // Returns true if the call needs to be issued
+        template <typename T>
+        static bool change(T& current, const T& value)
+        {
+            if (current == value) { counters.elided++; return false; }
+            current = value;
+            counters.issued++;
+            return true;
+        }
+
+        template <typename K>
+        static bool change(std::unordered_map<K, GLuint>& map, K key, GLuint value)
+        {
+            // Everything is bound to zero when the context is created
+            auto [it, inserted] = map.try_emplace(key, 0);
+            return change(it->second, value);
+        }
+
+    public:
+        static void useProgram(GLuint program)
+        {
+            if (change(state.program, program)) { glUseProgram(program); gl::checkError(); }
+        }
+
+        static void bindFramebuffer(GLuint framebuffer)
+        {
+            if (change(state.framebuffer, framebuffer)) { glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); gl::checkError(); }
+        }
+
+        static void bindRenderbuffer(GLuint renderbuffer)
+        {
+            if (change(state.renderbuffer, renderbuffer)) { glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer); gl::checkError(); }
+        }
+
+        static void bindVertexArray(GLuint vertexArray)
+        {
+            if (change(state.vertexArray, vertexArray)) { glBindVertexArray(vertexArray); gl::checkError(); }
+        }
+
+        static void bindBuffer(GLenum target, GLuint buffer)
+        {
+            // The element array binding belongs to the vertex array object, so it cannot be tracked globally
+            if (target == GL_ELEMENT_ARRAY_BUFFER) counters.issued++;
+            else if (!change(state.buffers, target, buffer)) return;
+            glBindBuffer(target, buffer); gl::checkError();
+        }
+
+        static void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+        {
+            // glBindBufferBase also changes the generic binding point, but only when it is actually issued
+            if (!change(state.indexedBuffers, key(index, target), buffer)) return;
+            state.buffers[target] = buffer;
+            glBindBufferBase(target, index, buffer); gl::checkError();
+        }
+
+        static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+        {
+            // The ranges are not tracked, so they are always issued, and the next whole binding must be too
+            state.indexedBuffers[key(index, target)] = UnknownBuffer;
+            state.buffers[target] = buffer;
+            counters.issued++;
+            glBindBufferRange(target, index, buffer, offset, size); gl::checkError();
+        }
+
+        static void activeTexture(GLuint unit)
+        {
+            if (change(state.activeTexture, unit)) { glActiveTexture(GL_TEXTURE0 + unit); gl::checkError(); }
+        }
+
+        // Binds to the active texture unit
+        static void bindTexture(GLenum target, GLuint texture)
+        {
+            if (change(state.textures, key(state.activeTexture, target), texture)) { glBindTexture(target, texture); gl::checkError(); }
+        }
+
+        static void bindTexture(GLuint unit, GLenum target, GLuint texture)
+        {
+            // Only switch the active unit when there is something to bind
+            auto it = state.textures.find(key(unit, target));
+            if (it != state.textures.end() ? it->second == texture : texture == 0) { counters.elided++; return; }
+            activeTexture(unit);
+            bindTexture(target, texture);
+        }
+
+        static void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+        {
+            if (change(state.viewport, glm::ivec4(x, y, width, height))) { glViewport(x, y, width, height); gl::checkError(); }
+        }
+
+        static void setEnabled(GLenum capability, bool enabled)
+        {
+            // Capabilities are only known after they are first set
+            auto [it, inserted] = state.capabilities.try_emplace(capability, !enabled);
+            if (!change(it->second, enabled)) return;
+            if (enabled) glEnable(capability);
+            else glDisable(capability);
+            gl::checkError();
+        }
+
+        static void enable(GLenum capability) { setEnabled(capability, true); }
+        static void disable(GLenum capability) { setEnabled(capability, false); }
+
+        // Deleting a bound object reverts its bindings to zero, and its name may be reused afterwards
+        static void forgetFramebuffer(GLuint framebuffer) { if (state.framebuffer == framebuffer) state.framebuffer = 0; }
+        static void forgetRenderbuffer(GLuint renderbuffer) { if (state.renderbuffer == renderbuffer) state.renderbuffer = 0; }
+        static void forgetVertexArray(GLuint vertexArray) { if (state.vertexArray == vertexArray) state.vertexArray = 0; }
+
+        static void forgetTexture(GLuint texture)
+        {
+            for (auto& [key, bound] : state.textures)
+                if (bound == texture) bound = 0;
+        }
+
+        static void forgetBuffer(GLuint buffer)
+        {
+            for (auto& [target, bound] : state.buffers)
+                if (bound == buffer) bound = 0;
+            for (auto& [key, bound] : state.indexedBuffers)
+                if (bound == buffer) bound = 0;
+        }
+
+        static const StateCounters& getCounters() { return counters; }
+        static void resetCounters() { counters = StateCounters(); }
+    };
+
+    inline thread_local StateCache::State StateCache::state;
+}
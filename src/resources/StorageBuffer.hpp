@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <string>
+#include "StateCache.hpp"
+#include "wrappers/glException.hpp"
+
+namespace gl
+{
+    // A shader storage buffer, which compute shaders can also write to
+    class StorageBuffer final
+    {
+        GLuint buffer;
+        GLsizeiptr size;
+        std::string name;
+
+    public:
+        StorageBuffer() : size(0) { glCreateBuffers(1, &buffer); gl::checkError(); }
+        ~StorageBuffer() { glDeleteBuffers(1, &buffer); gl::checkError(); StateCache::forgetBuffer(buffer); }
+
+        // Disallow copying
+        StorageBuffer(const StorageBuffer&) = delete;
+        StorageBuffer& operator=(const StorageBuffer&) = delete;
+
+        // Enable moving
+        StorageBuffer(StorageBuffer&& o) noexcept : buffer(o.buffer), size(o.size), name(std::move(o.name)) { o.buffer = 0; o.size = 0; }
+        StorageBuffer& operator=(StorageBuffer&& o) noexcept
+        {
+            std::swap(buffer, o.buffer);
+            std::swap(size, o.size);
+            std::swap(name, o.name);
+            return *this;
+        }
+
+        void setName(const std::string& name)
+        {
+            this->name = name;
+            glObjectLabel(GL_BUFFER, buffer, (GLsizei)name.size(), name.data()); gl::checkError();
+        }
+
+        void bind() const { StateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer); }
+        void bindTo(GLuint index) const { StateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, index, buffer); }
+
+        GLsizeiptr getSize() const { return size; }
+
+        // The contents are rewritten every frame, so the buffer is only replaced when it grows, since its storage is immutable.
+        // The new buffer has to be bound again
+        void allocate(GLsizeiptr newSize)
+        {
+            if (newSize <= size) return;
+            if (size > 0)
+            {
+                glDeleteBuffers(1, &buffer); gl::checkError();
+                StateCache::forgetBuffer(buffer);
+                glCreateBuffers(1, &buffer); gl::checkError();
+                if (!name.empty()) { glObjectLabel(GL_BUFFER, buffer, (GLsizei)name.size(), name.data()); gl::checkError(); }
+            }
+
+            glNamedBufferStorage(buffer, newSize, nullptr, GL_DYNAMIC_STORAGE_BIT); gl::checkError();
+            size = newSize;
+        }
+
+        void upload(const void* data, GLsizeiptr dataSize)
+        {
+            allocate(dataSize);
+            if (dataSize > 0) { glNamedBufferSubData(buffer, 0, dataSize, data); gl::checkError(); }
+        }
+
+        void download(void* data, GLsizeiptr dataSize) const
+        {
+            glGetNamedBufferSubData(buffer, 0, dataSize, data); gl::checkError();
+        }
+    };
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "StateCache.hpp"
+#include "wrappers/glException.hpp"
+
+namespace gl
+{
+    class StreamBufferException final : public std::runtime_error
+    {
+    public:
+        StreamBufferException(std::string what) : std::runtime_error(what) {}
+    };
+
+    struct StreamStats
+    {
+        std::size_t frames = 0, allocations = 0, bytes = 0;
+        std::size_t wraps = 0;    // The times the allocations went around the buffer
+
+        // The allocations which had to wait for the GPU to be done with the memory, and for how long in milliseconds
+        std::size_t stalls = 0;
+        double stallTime = 0;
+    };
+
+    // A ring of memory which stays mapped, so the data that changes every frame is written right where the GPU
+    // reads it, without a copy by the driver. Each frame is fenced when it ends, and its memory is only written
+    // again once the GPU has passed the fence, so the data of a frame is valid until the end of that frame
+    class StreamBuffer final
+    {
+    public:
+        struct Allocation
+        {
+            GLuint buffer;
+            GLintptr offset;
+            GLsizeiptr size;
+            std::byte* data;
+
+            void bindTo(GLenum target, GLuint index) const { StateCache::bindBufferRange(target, index, buffer, offset, size); }
+        };
+
+    private:
+        struct Fence
+        {
+            GLsync sync;
+            std::uint64_t end;
+        };
+
+        GLuint buffer;
+        std::byte* mapped;
+        GLsizeiptr capacity, alignment;
+
+        // The positions only grow, and wrap around the buffer. Everything between tail and head may still be read
+        std::uint64_t head, tail, frameStart;
+        std::uint64_t lastFrameBytes;
+        std::deque<Fence> fences;
+        StreamStats stats;
+
+        // Frees the memory of the oldest fenced frame, if the GPU is done with it or after waiting for it
+        bool retire(bool wait)
+        {
+            auto& fence = fences.front();
+            auto result = glClientWaitSync(fence.sync, 0, 0); gl::checkError();
+            if (result == GL_TIMEOUT_EXPIRED)
+            {
+                if (!wait) return false;
+
+                auto then = std::chrono::high_resolution_clock::now();
+                while (result == GL_TIMEOUT_EXPIRED) { result = glClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); gl::checkError(); }
+                stats.stalls++;
+                stats.stallTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - then).count();
+            }
+            if (result == GL_WAIT_FAILED) throw StreamBufferException("Waiting for a stream buffer fence failed!");
+
+            glDeleteSync(fence.sync); gl::checkError();
+            tail = fence.end;
+            fences.pop_front();
+            return true;
+        }
+
+    public:
+        // Every allocation is aligned for uniform and storage buffer bindings, which also suits the vertex attributes
+        explicit StreamBuffer(GLsizeiptr size) : head(0), tail(0), frameStart(0), lastFrameBytes(0)
+        {
+            GLint uniformAlignment, storageAlignment;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment); gl::checkError();
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment); gl::checkError();
+            alignment = std::max<GLsizeiptr>({ 16, uniformAlignment, storageAlignment });
+            capacity = (size + alignment - 1) / alignment * alignment;
+
+            constexpr GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glCreateBuffers(1, &buffer); gl::checkError();
+            glNamedBufferStorage(buffer, capacity, nullptr, Flags); gl::checkError();
+            mapped = static_cast<std::byte*>(glMapNamedBufferRange(buffer, 0, capacity, Flags)); gl::checkError();
+        }
+
+        ~StreamBuffer()
+        {
+            for (const auto& fence : fences) { glDeleteSync(fence.sync); gl::checkError(); }
+
+            // Deleting the buffer also unmaps it
+            glDeleteBuffers(1, &buffer); gl::checkError();
+            StateCache::forgetBuffer(buffer);
+        }
+
+        // Disallow copying and moving, the allocations point into the buffer
+        StreamBuffer(const StreamBuffer&) = delete;
+        StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+        void setName(const std::string& name)
+        {
+            glObjectLabel(GL_BUFFER, buffer, (GLsizei)name.size(), name.data()); gl::checkError();
+        }
+
+        // The memory is only valid until the end of the frame. Empty allocations still get a few bytes, so they can be bound
+        Allocation allocate(GLsizeiptr size)
+        {
+            size = std::max<GLsizeiptr>(size, sizeof(std::uint32_t));
+            if (size > capacity) throw StreamBufferException("Allocation of " + std::to_string(size) + " bytes is larger than the stream buffer!");
+
+            // An allocation never straddles the end of the buffer
+            auto offset = (head + alignment - 1) / alignment * alignment;
+            if (offset % capacity + size > std::uint64_t(capacity)) offset = (offset / capacity + 1) * capacity;
+
+            auto end = offset + size;
+            if (end - frameStart > std::uint64_t(capacity))
+                throw StreamBufferException("The data of a single frame does not fit in the stream buffer!");
+
+            // Only the frames which are still in the way are waited for
+            while (end - tail > std::uint64_t(capacity)) retire(true);
+
+            head = end;
+            stats.wraps = (end - 1) / capacity;
+            stats.allocations++;
+            stats.bytes += size;
+            return { buffer, GLintptr(offset % capacity), size, mapped + offset % capacity };
+        }
+
+        Allocation upload(const void* data, GLsizeiptr size)
+        {
+            auto allocation = allocate(size);
+            if (size > 0) std::memcpy(allocation.data, data, size);
+            return allocation;
+        }
+
+        template <typename T>
+        Allocation upload(const std::vector<T>& data) { return upload(data.data(), GLsizeiptr(data.size() * sizeof(T))); }
+
+        // Fences the data written since the last frame, once all the commands which read it were issued
+        void endFrame()
+        {
+            lastFrameBytes = head - frameStart;
+            if (head != frameStart) { fences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), head }); gl::checkError(); }
+            frameStart = head;
+            stats.frames++;
+
+            // The frames the GPU is already done with are freed without waiting
+            while (!fences.empty() && retire(false));
+        }
+
+        GLsizeiptr getCapacity() const { return capacity; }
+
+        // The bytes taken by the last frame, with the padding of the alignment and the wraps
+        std::size_t getLastFrameBytes() const { return lastFrameBytes; }
+        const StreamStats& getStats() const { return stats; }
+    };
+}
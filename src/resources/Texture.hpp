@@ -5,6 +5,7 @@
 #include <type_traits>
 #include <string>
 #include "TextureFormats.hpp"
+#include "StateCache.hpp"
 #include "wrappers/glParamFromType.hpp"
 #include "wrappers/glDepthComparisonMode.hpp"
 #include "wrappers/glException.hpp"
@@ -79,10 +80,9 @@ namespace gl
     {
     protected:
         GLuint texture;
-        static inline thread_local GLuint lastBoundTexture = 0;
 
         TextureBase(GLuint texture) : texture(texture) {}
-        ~TextureBase() { glDeleteTextures(1, &texture); gl::checkError(); }
+        ~TextureBase() { glDeleteTextures(1, &texture); gl::checkError(); StateCache::forgetTexture(texture); }
 
     public:
         constexpr static auto NumDimensions = getDimensionsFrom(Target);
@@ -105,38 +105,42 @@ namespace gl
             glObjectLabel(GL_TEXTURE, texture, (GLsizei)name.size(), name.data()); gl::checkError();
         }
 
-        void bind() const
+        void bind() const { StateCache::bindTexture(Target, texture); }
+        void bindTo(GLuint unit) const { StateCache::bindTexture(unit, Target, texture); }
+
+        // Image units are not tracked by the state cache, since only compute passes use them
+        void bindImageTo(GLuint unit, InternalFormat format, GLenum access = GL_READ_WRITE, GLint level = 0) const
         {
-            if (lastBoundTexture != texture)
-            {
-                glBindTexture(Target, texture); gl::checkError();
-                lastBoundTexture = texture;
-            }
+            glBindImageTexture(unit, texture, level, GL_FALSE, 0, access, static_cast<GLenum>(format)); gl::checkError();
         }
 
-        void bindTo(GLuint unit) const
+        void getImage(GLint level, GLenum format, GLenum type, void* data, std::size_t size) const
         {
-            glActiveTexture(GL_TEXTURE0 + unit); gl::checkError();
-            glBindTexture(Target, texture); gl::checkError();
-            lastBoundTexture = 0;
+            glGetTextureImage(texture, level, format, type, (GLsizei)size, data); gl::checkError();
         }
 
-        void generateMipmap() { this->bind(); glGenerateMipmap(Target); gl::checkError(); }
+        void generateMipmap() { glGenerateTextureMipmap(texture); gl::checkError(); }
 
-        void setMagFilter(MagFilter filter) { this->bind(); glTexParameteri(Target, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(filter)); gl::checkError(); }
-        void setMinFilter(MinFilter filter) { this->bind(); glTexParameteri(Target, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(filter)); gl::checkError(); }
-        void setMaxAnisotropy(float f) { this->bind(); glTexParameterf(Target, GL_TEXTURE_MAX_ANISOTROPY, f); gl::checkError(); }
+        void setMagFilter(MagFilter filter) { glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(filter)); gl::checkError(); }
+        void setMinFilter(MinFilter filter) { glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(filter)); gl::checkError(); }
+        void setMaxAnisotropy(float f) { glTextureParameterf(texture, GL_TEXTURE_MAX_ANISOTROPY, f); gl::checkError(); }
 
-        void setBorderColor(const glm::vec4& color) { this->bind(); glTexParameterfv(Target, GL_TEXTURE_BORDER_COLOR, &color.x); gl::checkError(); }
+        // Restricts the levels which can be sampled (and are needed for completeness)
+        void setLevelRange(GLint base, GLint max)
+        {
+            glTextureParameteri(texture, GL_TEXTURE_BASE_LEVEL, base); gl::checkError();
+            glTextureParameteri(texture, GL_TEXTURE_MAX_LEVEL, max); gl::checkError();
+        }
+
+        void setBorderColor(const glm::vec4& color) { glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, &color.x); gl::checkError(); }
 
         void enableComparisonMode(ComparisonFunction func = ComparisonFunction::Less)
         {
-            this->bind();
-            glTexParameteri(Target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE); gl::checkError();
-            glTexParameteri(Target, GL_TEXTURE_COMPARE_FUNC, static_cast<GLint>(func)); gl::checkError();
+            glTextureParameteri(texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE); gl::checkError();
+            glTextureParameteri(texture, GL_TEXTURE_COMPARE_FUNC, static_cast<GLint>(func)); gl::checkError();
         }
 
-        void clearComparisonMode() { this->bind(); glTexParameteri(Target, GL_TEXTURE_COMPARE_MODE, GL_NONE); gl::checkError(); }
+        void clearComparisonMode() { glTextureParameteri(texture, GL_TEXTURE_COMPARE_MODE, GL_NONE); gl::checkError(); }
 
         friend class Framebuffer;
     };
@@ -154,19 +158,19 @@ namespace gl
         TextureDimensions(GLuint texture) : TextureBase<Target>(texture) {}
 
     public:
-        template <typename T>
-        void assign(GLint level, InternalFormat internalFormat, GLsizei width, Format format, const T* data)
+        // The storage is immutable, so it can only be given once
+        void storage(GLsizei levels, InternalFormat internalFormat, GLsizei width)
         {
-            this->bind(); glTexImage1D(Target, level, static_cast<GLenum>(internalFormat), width,
-                0, static_cast<GLenum>(format), ParamFromType<T>, data); gl::checkError();
+            glTextureStorage1D(this->texture, levels, static_cast<GLenum>(internalFormat), width); gl::checkError();
         }
 
-        void assign(GLint level, InternalFormat internalFormat, GLsizei width)
+        template <typename T>
+        void upload(GLint level, GLsizei width, Format format, const T* data)
         {
-            assign(level, internalFormat, width, deriveDefaultFormat(internalFormat), static_cast<const float*>(nullptr));
+            glTextureSubImage1D(this->texture, level, 0, width, static_cast<GLenum>(format), ParamFromType<T>, data); gl::checkError();
         }
 
-        void setWrapEffectS(WrapEffect effect) { this->bind(); glTexParameteri(Target, GL_TEXTURE_WRAP_S, static_cast<GLint>(effect)); gl::checkError(); }
+        void setWrapEffectS(WrapEffect effect) { glTextureParameteri(this->texture, GL_TEXTURE_WRAP_S, static_cast<GLint>(effect)); gl::checkError(); }
     };
 
     template <GLenum Target>
@@ -176,21 +180,20 @@ namespace gl
         TextureDimensions(GLuint texture) : TextureBase<Target>(texture) {}
 
     public:
-        template <typename T>
-        void assign(GLint level, InternalFormat internalFormat, GLsizei width, GLsizei height, Format format, const T* data)
+        // The storage is immutable, so it can only be given once
+        void storage(GLsizei levels, InternalFormat internalFormat, GLsizei width, GLsizei height)
         {
-            this->bind(); glTexImage2D(Target, level, static_cast<GLenum>(internalFormat), width, height,
-                0, static_cast<GLenum>(format), ParamFromType<T>, data); gl::checkError();
+            glTextureStorage2D(this->texture, levels, static_cast<GLenum>(internalFormat), width, height); gl::checkError();
         }
 
-        void assign(GLint level, InternalFormat internalFormat, GLsizei width, GLsizei height)
+        template <typename T>
+        void upload(GLint level, GLsizei width, GLsizei height, Format format, const T* data)
         {
-            this->bind(); glTexImage2D(Target, level, static_cast<GLenum>(internalFormat), width, height,
-                0, static_cast<GLenum>(deriveDefaultFormat(internalFormat)), deriveDefaultType(internalFormat), nullptr);; gl::checkError();
+            glTextureSubImage2D(this->texture, level, 0, 0, width, height, static_cast<GLenum>(format), ParamFromType<T>, data); gl::checkError();
         }
 
-        void setWrapEffectS(WrapEffect effect) { this->bind(); glTexParameteri(Target, GL_TEXTURE_WRAP_S, static_cast<GLint>(effect)); gl::checkError(); }
-        void setWrapEffectT(WrapEffect effect) { this->bind(); glTexParameteri(Target, GL_TEXTURE_WRAP_T, static_cast<GLint>(effect)); gl::checkError(); }
+        void setWrapEffectS(WrapEffect effect) { glTextureParameteri(this->texture, GL_TEXTURE_WRAP_S, static_cast<GLint>(effect)); gl::checkError(); }
+        void setWrapEffectT(WrapEffect effect) { glTextureParameteri(this->texture, GL_TEXTURE_WRAP_T, static_cast<GLint>(effect)); gl::checkError(); }
     };
 
     template <GLenum Target>
@@ -200,21 +203,21 @@ namespace gl
         TextureDimensions(GLuint texture) : TextureBase<Target>(texture) {}
 
     public:
-        template <typename T>
-        void assign(GLint level, InternalFormat internalFormat, GLsizei width, GLsizei height, GLsizei depth, Format format, const T* data)
+        // The storage is immutable, so it can only be given once
+        void storage(GLsizei levels, InternalFormat internalFormat, GLsizei width, GLsizei height, GLsizei depth)
         {
-            this->bind(); glTexImage3D(Target, level, static_cast<GLenum>(internalFormat), width, height, depth,
-                0, static_cast<GLenum>(format), ParamFromType<T>, data); gl::checkError();
+            glTextureStorage3D(this->texture, levels, static_cast<GLenum>(internalFormat), width, height, depth); gl::checkError();
         }
 
-        void assign(GLint level, InternalFormat internalFormat, GLsizei width, GLsizei height, GLsizei depth)
+        template <typename T>
+        void upload(GLint level, GLsizei width, GLsizei height, GLsizei depth, Format format, const T* data)
         {
-            assign(level, internalFormat, width, height, depth, deriveDefaultFormat(internalFormat), static_cast<const float*>(nullptr));
+            glTextureSubImage3D(this->texture, level, 0, 0, 0, width, height, depth, static_cast<GLenum>(format), ParamFromType<T>, data); gl::checkError();
         }
 
-        void setWrapEffectS(WrapEffect effect) { this->bind(); glTexParameteri(Target, GL_TEXTURE_WRAP_S, static_cast<GLint>(effect)); gl::checkError(); }
-        void setWrapEffectT(WrapEffect effect) { this->bind(); glTexParameteri(Target, GL_TEXTURE_WRAP_T, static_cast<GLint>(effect)); gl::checkError(); }
-        void setWrapEffectR(WrapEffect effect) { this->bind(); glTexParameteri(Target, GL_TEXTURE_WRAP_R, static_cast<GLint>(effect)); gl::checkError(); }
+        void setWrapEffectS(WrapEffect effect) { glTextureParameteri(this->texture, GL_TEXTURE_WRAP_S, static_cast<GLint>(effect)); gl::checkError(); }
+        void setWrapEffectT(WrapEffect effect) { glTextureParameteri(this->texture, GL_TEXTURE_WRAP_T, static_cast<GLint>(effect)); gl::checkError(); }
+        void setWrapEffectR(WrapEffect effect) { glTextureParameteri(this->texture, GL_TEXTURE_WRAP_R, static_cast<GLint>(effect)); gl::checkError(); }
     };
 
     template <GLenum Target>
@@ -226,7 +229,7 @@ namespace gl
     public:
         static Texture none() { return Texture(0); }
 
-        Texture() : TexDim<Target>(0) { glGenTextures(1, &this->texture); gl::checkError(); }
+        Texture() : TexDim<Target>(0) { glCreateTextures(Target, 1, &this->texture); gl::checkError(); }
 
         Texture(const Texture&) = delete;
         Texture& operator=(const Texture&) = delete;
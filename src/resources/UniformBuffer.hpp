@@ -2,29 +2,38 @@
 
 #include <glad/glad.h>
 #include <algorithm>
+#include <stdexcept>
 #include <string>
+#include "StateCache.hpp"
 #include "wrappers/glException.hpp"
 
 namespace gl
 {
+    class UniformBufferException final : public std::runtime_error
+    {
+    public:
+        UniformBufferException(std::string what) : std::runtime_error(what) {}
+    };
+
     class UniformBuffer final
     {
         GLuint buffer;
-        inline static thread_local GLuint lastBufferBound = 0;
+        GLsizeiptr size;
 
     public:
-        UniformBuffer() { glGenBuffers(1, &buffer); gl::checkError(); }
-        ~UniformBuffer() { glDeleteBuffers(1, &buffer); gl::checkError(); }
+        UniformBuffer() : size(0) { glCreateBuffers(1, &buffer); gl::checkError(); }
+        ~UniformBuffer() { glDeleteBuffers(1, &buffer); gl::checkError(); StateCache::forgetBuffer(buffer); }
 
         // Disallow copying
         UniformBuffer(const UniformBuffer&) = delete;
         UniformBuffer& operator=(const UniformBuffer&) = delete;
 
         // Enable moving
-        UniformBuffer(UniformBuffer&& o) noexcept : buffer(o.buffer) { o.buffer = 0; }
+        UniformBuffer(UniformBuffer&& o) noexcept : buffer(o.buffer), size(o.size) { o.buffer = 0; o.size = 0; }
         UniformBuffer& operator=(UniformBuffer&& o) noexcept
         {
             std::swap(buffer, o.buffer);
+            std::swap(size, o.size);
             return *this;
         }
 
@@ -33,24 +42,15 @@ namespace gl
             glObjectLabel(GL_BUFFER, buffer, name.size(), name.data()); gl::checkError();
         }
 
-        void bind() const
-        {
-            if (lastBufferBound != buffer)
-            {
-                glBindBuffer(GL_UNIFORM_BUFFER, buffer); gl::checkError();
-                lastBufferBound = buffer;
-            }
-        }
-
-        void bindTo(GLuint index) const
-        {
-            glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer); gl::checkError();
-            lastBufferBound = 0;
-        }
+        void bind() const { StateCache::bindBuffer(GL_UNIFORM_BUFFER, buffer); }
+        void bindTo(GLuint index) const { StateCache::bindBufferBase(GL_UNIFORM_BUFFER, index, buffer); }
 
-        void upload(const void* data, GLsizeiptr size)
+        // The storage is immutable, so it is only created by the first upload, and every other one must have the same size
+        void upload(const void* data, GLsizeiptr dataSize)
         {
-            bind(); glBufferData(GL_UNIFORM_BUFFER, size, data, GL_STATIC_DRAW); gl::checkError();
+            if (size == 0) { glNamedBufferStorage(buffer, dataSize, data, GL_DYNAMIC_STORAGE_BIT); gl::checkError(); size = dataSize; }
+            else if (dataSize == size) { glNamedBufferSubData(buffer, 0, dataSize, data); gl::checkError(); }
+            else throw UniformBufferException("Uploading " + std::to_string(dataSize) + " bytes to a uniform buffer of " + std::to_string(size) + " bytes!");
         }
 
         template <typename T, std::size_t N>
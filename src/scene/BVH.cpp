@@ -0,0 +1,75 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace scene;
+
+constexpr std::size_t MaxLeafObjects = 2;
+
+BVH::BVH(std::span<const AABB> bounds) : objectIndices(bounds.size())
+{
+    std::iota(objectIndices.begin(), objectIndices.end(), std::size_t(0));
+    if (!bounds.empty()) buildNode(bounds, 0, bounds.size());
+}
+
+std::size_t BVH::buildNode(std::span<const AABB> bounds, std::size_t first, std::size_t count)
+{
+    auto begin = objectIndices.begin() + first, end = begin + count;
+
+    auto nodeIndex = nodes.size();
+    auto& node = nodes.emplace_back();
+    node.bounds = std::accumulate(begin + 1, end, bounds[*begin],
+        [&](const AABB& box, std::size_t i) { return box.merge(bounds[i]); });
+    node.first = first;
+    node.count = count;
+    node.right = 0;
+    if (count <= MaxLeafObjects) return nodeIndex;
+
+    // Split at the median of the object centers, along the axis where they are the most spread
+    auto centers = std::accumulate(begin + 1, end, AABB{ bounds[*begin].center(), bounds[*begin].center() },
+        [&](const AABB& box, std::size_t i) { return box.merge({ bounds[i].center(), bounds[i].center() }); });
+    auto extent = centers.max - centers.min;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+
+    auto half = count / 2;
+    std::nth_element(begin, begin + half, end,
+        [&](std::size_t a, std::size_t b) { return bounds[a].center()[axis] < bounds[b].center()[axis]; });
+
+    // The node reference can be invalidated by the recursive calls
+    buildNode(bounds, first, half);
+    auto right = buildNode(bounds, first + half, count - half);
+    nodes[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+std::size_t BVH::cull(const util::Frustum& frustum, std::vector<std::size_t>& visible) const
+{
+    std::size_t culled = 0;
+    if (nodes.empty()) return culled;
+
+    std::vector<std::size_t> stack{ 0 };
+    while (!stack.empty())
+    {
+        const auto& node = nodes[stack.back()];
+        auto nodeIndex = stack.back();
+        stack.pop_back();
+
+        // A whole subtree goes away (or stays) at once
+        auto test = frustum.classifyAABB(node.bounds.min, node.bounds.max);
+        if (test == util::FrustumTest::Outside)
+        {
+            culled += node.count;
+            continue;
+        }
+
+        if (test == util::FrustumTest::Intersecting && node.right != 0)
+        {
+            stack.push_back(node.right);
+            stack.push_back(nodeIndex + 1);
+        }
+        else visible.insert(visible.end(), objectIndices.begin() + node.first, objectIndices.begin() + node.first + node.count);
+    }
+
+    return culled;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <span>
+#include <cstddef>
+#include "util/Frustum.hpp"
+
+namespace scene
+{
+    struct AABB
+    {
+        glm::vec3 min, max;
+
+        glm::vec3 center() const { return (min + max) / 2.0f; }
+        AABB merge(const AABB& other) const { return { glm::min(min, other.min), glm::max(max, other.max) }; }
+    };
+
+    // A bounding-volume hierarchy over the bounds of the scene objects, used to cull them
+    // against a frustum without testing every single one of them
+    class BVH final
+    {
+        struct Node
+        {
+            AABB bounds;
+            std::size_t first, count; // The range of objectIndices under this node
+            std::size_t right;        // The left child is always the next node, 0 for leaves
+        };
+
+        std::vector<Node> nodes;
+        std::vector<std::size_t> objectIndices;
+
+        std::size_t buildNode(std::span<const AABB> bounds, std::size_t first, std::size_t count);
+
+    public:
+        BVH() = default;
+        BVH(std::span<const AABB> bounds);
+
+        // Fills visible with the indices of the objects which intersect the frustum, returning the number of culled ones
+        std::size_t cull(const util::Frustum& frustum, std::vector<std::size_t>& visible) const;
+    };
+}
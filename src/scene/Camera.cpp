@@ -8,7 +8,13 @@ constexpr float PixelsPerFullRotation = 450;
 constexpr float MoveSpeed = 10.0f;
 constexpr float Pi = 3.14159265359f;
 
-Camera::Camera(glfw::Window& window, float zFar) : position(), angles()
+Camera::Camera(glfw::Size size, float zFar) : lastPos(), position(), angles()
+{
+    projection = glm::perspective(glm::radians(45.0f), (float)size.width / size.height, 0.5f, zFar);
+    infiniteProjection = glm::infinitePerspective(glm::radians(45.0f), (float)size.width / size.height, 0.5f);
+}
+
+Camera::Camera(glfw::Window& window, float zFar) : Camera(window.getFramebufferSize(), zFar)
 {
     // Disable the cursor for this window, in order to take control of the camera
     window.setCursorMode(glfw::CursorMode::Disabled);
@@ -16,10 +22,6 @@ Camera::Camera(glfw::Window& window, float zFar) : position(), angles()
         window.setRawMouseMotionEnabled();
 
     lastPos = window.getCursorPos();
-
-    auto fsize = window.getFramebufferSize();
-    projection = glm::perspective(glm::radians(45.0f), (float)fsize.width / fsize.height, 0.5f, zFar);
-    infiniteProjection = glm::infinitePerspective(glm::radians(45.0f), (float)fsize.width / fsize.height, 0.5f);
 }
 
 void Camera::update(glfw::Window& window, float delta)
@@ -45,6 +47,14 @@ void Camera::update(glfw::Window& window, float delta)
     lastPos = pos;
 }
 
+void Camera::lookAt(const glm::vec3& target)
+{
+    // Invert the forward vector computed in update, which is (-sin(x)cos(y), sin(y), -cos(x)cos(y))
+    auto dir = glm::normalize(target - position);
+    angles.x = std::atan2(-dir.x, -dir.z);
+    angles.y = std::asin(glm::clamp(dir.y, -1.0f, 1.0f));
+}
+
 glm::mat4 Camera::getViewMatrix() const
 {
     // The "camera" matrix is interpreted as being
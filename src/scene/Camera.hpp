@@ -14,8 +14,10 @@ namespace scene
         glm::mat4 projection;
         glm::mat4 infiniteProjection;
 
+        Camera(glfw::Size size, float zFar);
         Camera(glfw::Window& window, float zFar);
         void update(glfw::Window& window, float delta);
+        void lookAt(const glm::vec3& target);
         glm::mat4 getViewMatrix() const;
     };
 }
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include "FrameGraph.hpp"
+
+#include <algorithm>
+
+using namespace scene;
+
+static std::size_t bytesPerPixel(gl::InternalFormat format)
+{
+    switch (format)
+    {
+    case gl::InternalFormat::RGBA8:
+    case gl::InternalFormat::RG16f:
+    case gl::InternalFormat::RG16i:
+    case gl::InternalFormat::R32f:
+    case gl::InternalFormat::Depth32f: return 4;
+    case gl::InternalFormat::RGBA16f: return 8;
+    default: throw FrameGraphException("Unknown size for the format of a transient texture!");
+    }
+}
+
+std::size_t TransientTexture::bytes() const
+{
+    std::size_t total = 0;
+    auto levelWidth = width, levelHeight = height;
+    for (GLint level = 0; level < levels; level++)
+    {
+        total += std::size_t(levelWidth) * levelHeight * bytesPerPixel(format);
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+    return total;
+}
+
+FrameGraph::Resource FrameGraph::Builder::create(std::string name, const TransientTexture& texture)
+{
+    graph.resources.push_back({ std::move(name), texture, None, None });
+    auto version = graph.addVersion(graph.resources.size() - 1, pass);
+    graph.passes[pass].writes.push_back(version);
+    return version;
+}
+
+void FrameGraph::Builder::read(Resource resource)
+{
+    if (resource >= graph.versions.size()) throw FrameGraphException("Pass " + graph.passes[pass].name + " reads an unknown resource!");
+    graph.passes[pass].reads.push_back(resource);
+}
+
+FrameGraph::Resource FrameGraph::Builder::write(Resource resource)
+{
+    // Only the last version can be written, otherwise two passes would write the same one
+    read(resource);
+    auto& node = graph.resources[graph.versions[resource].resource];
+    if (node.latest != resource)
+        throw FrameGraphException("Pass " + graph.passes[pass].name + " writes an old version of " + node.name + "!");
+
+    // The pass may keep what was already there, so it also reads the last version
+    auto version = graph.addVersion(graph.versions[resource].resource, pass);
+    graph.passes[pass].writes.push_back(version);
+    return version;
+}
+
+void FrameGraph::Builder::setExecute(std::function<void(FrameGraph&)> execute)
+{
+    graph.passes[pass].execute = std::move(execute);
+}
+
+FrameGraph::Resource FrameGraph::addVersion(std::size_t resource, std::size_t writer)
+{
+    versions.push_back({ resource, writer, false });
+    resources[resource].latest = versions.size() - 1;
+    compiled = false;
+    return versions.size() - 1;
+}
+
+void FrameGraph::reset()
+{
+    passes.clear();
+    resources.clear();
+    versions.clear();
+    order.clear();
+    compiled = false;
+}
+
+FrameGraph::Builder FrameGraph::addPass(std::string name, std::string zone)
+{
+    passes.push_back({ std::move(name), std::move(zone), {}, {}, {}, false });
+    compiled = false;
+    return Builder(*this, passes.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::import(std::string name)
+{
+    resources.push_back({ std::move(name), std::nullopt, None, None });
+    return addVersion(resources.size() - 1, None);
+}
+
+void FrameGraph::markOutput(Resource resource)
+{
+    versions.at(resource).output = true;
+    compiled = false;
+}
+
+void FrameGraph::compile()
+{
+    sortPasses();
+    cullPasses();
+    allocateTextures();
+    compiled = true;
+}
+
+void FrameGraph::sortPasses()
+{
+    // Each pass runs after the writers of what it reads. When several can run, the first declared goes first
+    std::vector<bool> done(passes.size());
+    order.clear();
+    while (order.size() < passes.size())
+    {
+        auto ready = [&](std::size_t index)
+        {
+            return std::ranges::all_of(passes[index].reads, [&](Resource resource)
+            {
+                auto writer = versions[resource].writer;
+                return writer == None || writer == index || done[writer];
+            });
+        };
+
+        std::size_t next = 0;
+        while (next < passes.size() && (done[next] || !ready(next))) next++;
+        if (next == passes.size()) throw FrameGraphException("The passes of the frame graph depend on each other in a cycle!");
+
+        done[next] = true;
+        order.push_back(next);
+    }
+}
+
+void FrameGraph::cullPasses()
+{
+    // Going backwards, the passes which read a version come before the pass which wrote it
+    std::vector<bool> used(versions.size());
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        auto& pass = passes[*it];
+        pass.culled = std::ranges::none_of(pass.writes, [&](Resource resource) { return versions[resource].output || used[resource]; });
+        if (!pass.culled)
+            for (auto resource : pass.reads) used[resource] = true;
+    }
+}
+
+void FrameGraph::allocateTextures()
+{
+    // The span of each transient texture, in the order the passes run
+    std::vector<std::size_t> firstUse(resources.size(), None), lastUse(resources.size(), None);
+    for (std::size_t position = 0; position < order.size(); position++)
+    {
+        const auto& pass = passes[order[position]];
+        if (pass.culled) continue;
+
+        for (const auto* list : { &pass.reads, &pass.writes })
+            for (auto resource : *list)
+            {
+                auto index = versions[resource].resource;
+                if (firstUse[index] == None) firstUse[index] = position;
+                lastUse[index] = position;
+            }
+    }
+
+    stats = { passes.size(), 0, 0, 0, 0, 0 };
+    for (const auto& pass : passes) stats.culledPasses += pass.culled;
+
+    std::vector<std::size_t> transients;
+    for (std::size_t i = 0; i < resources.size(); i++)
+    {
+        resources[i].physical = None;
+        if (!resources[i].texture) continue;
+        stats.unaliasedBytes += resources[i].texture->bytes();
+        if (firstUse[i] != None) transients.push_back(i);
+    }
+    std::ranges::stable_sort(transients, {}, [&](std::size_t i) { return firstUse[i]; });
+
+    // Each texture takes the first allocated one with the same description which is free by then, so the
+    // textures are the same every frame as long as the passes are
+    for (auto& [id, physical] : physicalTextures) physical.lastUse = None;
+    for (auto i : transients)
+    {
+        auto& resource = resources[i];
+        auto it = std::ranges::find_if(physicalTextures, [&](const auto& entry)
+        {
+            const auto& physical = entry.second;
+            return physical.description == *resource.texture && (physical.lastUse == None || physical.lastUse < firstUse[i]);
+        });
+
+        if (it == physicalTextures.end())
+        {
+            const auto& description = *resource.texture;
+            auto texture = std::make_unique<gl::Texture2D>();
+            texture->storage(description.levels, description.format, description.width, description.height);
+
+            // The passes only fetch texels, but the mipmaps must be complete
+            texture->setMagFilter(gl::MagFilter::Nearest);
+            texture->setMinFilter(description.levels > 1 ? gl::MinFilter::NearestMipNearest : gl::MinFilter::Nearest);
+            texture->setLevelRange(0, description.levels - 1);
+            texture->setName(resource.name + " Texture");
+            it = physicalTextures.emplace(nextPhysicalTexture++, PhysicalTexture{ description, std::move(texture), None }).first;
+        }
+
+        it->second.lastUse = lastUse[i];
+        resource.physical = it->first;
+        stats.transientTextures++;
+    }
+
+    // The textures which this frame did not need are released, with their framebuffers
+    std::erase_if(framebuffers, [&](const auto& entry)
+    {
+        auto released = [&](std::size_t id) { return id != None && physicalTextures.at(id).lastUse == None; };
+        return std::ranges::any_of(entry.first.colors, released) || released(entry.first.depth);
+    });
+    std::erase_if(physicalTextures, [](const auto& entry) { return entry.second.lastUse == None; });
+
+    stats.physicalTextures = physicalTextures.size();
+    for (const auto& [id, physical] : physicalTextures) stats.allocatedBytes += physical.description.bytes();
+}
+
+void FrameGraph::execute(GpuProfiler& profiler)
+{
+    if (!compiled) throw FrameGraphException("The frame graph must be compiled before it runs!");
+
+    std::map<std::string, std::size_t> passesPerZone;
+    for (const auto& pass : passes)
+        if (!pass.culled && !pass.zone.empty()) passesPerZone[pass.zone]++;
+
+    std::optional<GpuProfiler::Scope> zone;
+    std::string activeZone;
+    for (auto index : order)
+    {
+        auto& pass = passes[index];
+        if (pass.culled) continue;
+
+        if (pass.zone != activeZone)
+        {
+            zone.reset();
+            activeZone = pass.zone;
+            if (!activeZone.empty()) zone.emplace(profiler, activeZone);
+        }
+
+        std::optional<GpuProfiler::Scope> passZone;
+        if (!pass.zone.empty() && passesPerZone[pass.zone] > 1) passZone.emplace(profiler, pass.name);
+        if (pass.execute) pass.execute(*this);
+    }
+}
+
+gl::Texture2D& FrameGraph::getTexture(Resource resource)
+{
+    const auto& node = resources[versions.at(resource).resource];
+    if (node.physical == None) throw FrameGraphException("The resource " + node.name + " has no texture!");
+    return *physicalTextures.at(node.physical).texture;
+}
+
+const gl::Texture2D& FrameGraph::getTexture(Resource resource) const
+{
+    return const_cast<FrameGraph*>(this)->getTexture(resource);
+}
+
+const gl::Framebuffer& FrameGraph::getFramebuffer(std::initializer_list<Resource> colors, std::optional<Resource> depth, GLint level)
+{
+    auto physicalOf = [&](Resource resource)
+    {
+        getTexture(resource);
+        return resources[versions[resource].resource].physical;
+    };
+
+    FramebufferKey key{ {}, depth ? physicalOf(*depth) : None, level };
+    for (auto resource : colors) key.colors.push_back(physicalOf(resource));
+
+    auto it = framebuffers.find(key);
+    if (it != framebuffers.end()) return it->second;
+
+    gl::Framebuffer framebuffer;
+    std::vector<gl::Attachment> drawBuffers;
+    std::string name = "Frame Graph Framebuffer";
+    for (auto resource : colors)
+    {
+        drawBuffers.push_back(gl::ColorAttachment((GLenum)drawBuffers.size()));
+        framebuffer.attach(drawBuffers.back(), getTexture(resource), level);
+        name += " " + resources[versions[resource].resource].name;
+    }
+    if (depth) framebuffer.attach(gl::DepthAttachment, getTexture(*depth), level);
+    framebuffer.setDrawBuffers(drawBuffers);
+    framebuffer.setName(name);
+    return framebuffers.emplace(std::move(key), std::move(framebuffer)).first->second;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "resources/Texture.hpp"
+#include "resources/Framebuffer.hpp"
+#include "GpuProfiler.hpp"
+
+namespace scene
+{
+    class FrameGraphException : public std::runtime_error
+    {
+    public:
+        FrameGraphException(std::string what) : std::runtime_error(what) {}
+    };
+
+    // A texture which only lives during one frame. Textures with the same description whose passes
+    // never overlap share the same memory
+    struct TransientTexture
+    {
+        gl::InternalFormat format;
+        GLsizei width, height;
+        GLint levels = 1;
+
+        bool operator==(const TransientTexture&) const = default;
+        std::size_t bytes() const;
+    };
+
+    // The passes of a frame, with the resources they read and write. The graph runs them in the order of their
+    // dependencies, leaves out the ones whose results are never used, and allocates the transient textures
+    // only for the passes which use them. It is built again every frame, but keeps its textures between frames
+    class FrameGraph final
+    {
+    public:
+        // Every write gives a new version of the resource, so reading a version also names the pass which wrote it
+        using Resource = std::size_t;
+
+        class Builder final
+        {
+            FrameGraph& graph;
+            std::size_t pass;
+
+            Builder(FrameGraph& graph, std::size_t pass) : graph(graph), pass(pass) {}
+
+        public:
+            // Creates a transient texture, which this pass writes first
+            Resource create(std::string name, const TransientTexture& texture);
+            void read(Resource resource);
+            Resource write(Resource resource);
+
+            // Runs once the passes it depends on have run, unless it is culled
+            void setExecute(std::function<void(FrameGraph&)> execute);
+
+            friend class FrameGraph;
+        };
+
+        struct Stats
+        {
+            std::size_t passes, culledPasses;
+            std::size_t transientTextures, physicalTextures;
+
+            // Every transient texture declared, even by the culled passes, each one with its own memory,
+            // like when each subsystem owns its textures, then the textures the graph actually allocated
+            std::size_t unaliasedBytes, allocatedBytes;
+        };
+
+    private:
+        static constexpr auto None = std::numeric_limits<std::size_t>::max();
+
+        struct Pass
+        {
+            std::string name;
+            std::string zone;
+            std::vector<Resource> reads, writes;
+            std::function<void(FrameGraph&)> execute;
+            bool culled;
+        };
+
+        struct ResourceNode
+        {
+            std::string name;
+            std::optional<TransientTexture> texture;  // Imported resources are owned elsewhere
+            std::size_t physical;                     // The allocated texture, if any
+            Resource latest;                          // The only version which can be written
+        };
+
+        struct Version
+        {
+            std::size_t resource;
+            std::size_t writer;
+            bool output;
+        };
+
+        // The allocated textures, which last until a frame does not need them
+        struct PhysicalTexture
+        {
+            TransientTexture description;
+            std::unique_ptr<gl::Texture2D> texture;
+            std::size_t lastUse;
+        };
+
+        struct FramebufferKey
+        {
+            std::vector<std::size_t> colors;
+            std::size_t depth;
+            GLint level;
+
+            auto operator<=>(const FramebufferKey&) const = default;
+        };
+
+        std::vector<Pass> passes;
+        std::vector<ResourceNode> resources;
+        std::vector<Version> versions;
+        std::vector<std::size_t> order;
+        std::map<std::size_t, PhysicalTexture> physicalTextures;
+        std::size_t nextPhysicalTexture;
+        std::map<FramebufferKey, gl::Framebuffer> framebuffers;
+        Stats stats;
+        bool compiled;
+
+        Resource addVersion(std::size_t resource, std::size_t writer);
+        void sortPasses();
+        void cullPasses();
+        void allocateTextures();
+
+    public:
+        FrameGraph() : nextPhysicalTexture(0), stats(), compiled(false) {}
+
+        // Starts a new frame, without any pass. The textures of the last frame stay valid until the next compile
+        void reset();
+
+        // The passes with a zone are timed in it by the profiler, so the passes sharing one must run one after the
+        // other. When several of them run, each one also gets its own zone inside
+        Builder addPass(std::string name, std::string zone = "");
+
+        // For the resources which outlive the frame, like the shadow cascades and the output
+        Resource import(std::string name);
+
+        // The passes which this version depends on are kept, and all the others are culled
+        void markOutput(Resource resource);
+
+        void compile();
+        void execute(GpuProfiler& profiler);
+
+        gl::Texture2D& getTexture(Resource resource);
+        const gl::Texture2D& getTexture(Resource resource) const;
+
+        // A framebuffer with the textures attached, whose draw buffers are the color attachments in order.
+        // It is kept as long as its textures are
+        const gl::Framebuffer& getFramebuffer(std::initializer_list<Resource> colors, std::optional<Resource> depth = std::nullopt,
+            GLint level = 0);
+
+        const Stats& getStats() const { return stats; }
+    };
+}
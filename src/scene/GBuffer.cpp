@@ -5,44 +5,48 @@
 
 using namespace scene;
 
-GBuffer::GBuffer(glfw::Size size) : width(size.width), height(size.height)
-{
-    // Assign all textures
-    colorTexture.assign(0, gl::InternalFormat::RGBA, size.width, size.height);
-    depthTexture.assign(0, gl::InternalFormat::Depth32f, size.width, size.height);
-    normalTexture.assign(0, gl::InternalFormat::RG16f, size.width, size.height);
-    specShinyTexture.assign(0, gl::InternalFormat::RG16f, size.width, size.height);
-
-    colorTexture.setName("G-Buffer Color Texture");
-    depthTexture.setName("G-Buffer Depth Texture");
-    normalTexture.setName("G-Buffer Normal Texture");
-    specShinyTexture.setName("G-Buffer Specular/Shininess Texture");
+// The depth goes in unit 2, and the other passes keep all of these clear of their own textures
+static constexpr GLuint TargetUnits[MaxGBufferTargets] = { 1, 3, 4 };
 
-    for (auto texture : { &colorTexture, &depthTexture, &normalTexture, &specShinyTexture })
-    {
-        texture->setMagFilter(gl::MagFilter::Linear);
-        texture->setMinFilter(gl::MinFilter::Linear);
-    }
+GBuffer::GBuffer(glfw::Size size, GBufferLayout layout) : targets(), depthTexture(nullptr), width(size.width), height(size.height),
+    layout(layout)
+{
+    gbufferProgram = cache::loadProgram({ "resources/shaders/gbuffer.vert", "resources/shaders/gbuffer.frag" });
+}
 
-    // Attach them
-    framebuffer.attach(gl::ColorAttachment(0), colorTexture);
-    framebuffer.attach(gl::ColorAttachment(1), normalTexture);
-    framebuffer.attach(gl::ColorAttachment(2), specShinyTexture);
-    framebuffer.attach(gl::DepthAttachment, depthTexture);
-    framebuffer.setDrawBuffers(gl::ColorAttachment(0), 
-        gl::ColorAttachment(1), gl::ColorAttachment(2));
-    framebuffer.setName("G-Buffer Framebuffer");
+GBufferTargets GBuffer::createTargets(FrameGraph::Builder& builder) const
+{
+    const auto& description = describeGBuffer(layout);
+    GBufferTargets result{ {}, description.targets.size(), 0 };
+    for (std::size_t i = 0; i < description.targets.size(); i++)
+        result.targets[i] = builder.create(std::string("G-Buffer ") + description.targets[i].name,
+            { description.targets[i].format, (GLsizei)width, (GLsizei)height });
+    result.depth = builder.create("G-Buffer Depth", { gl::InternalFormat::Depth32f, (GLsizei)width, (GLsizei)height });
+    return result;
+}
 
-    gbufferProgram = cache::loadProgram({ "resources/shaders/gbuffer.vert", "resources/shaders/gbuffer.frag" });
+void GBuffer::readTargets(FrameGraph::Builder& builder, const GBufferTargets& targets) const
+{
+    for (std::size_t i = 0; i < targets.numTargets; i++) builder.read(targets.targets[i]);
+    builder.read(targets.depth);
 }
 
-void GBuffer::begin()
+void GBuffer::begin(FrameGraph& graph, const GBufferTargets& targets)
 {
+    this->targets = {};
+    for (std::size_t i = 0; i < targets.numTargets; i++) this->targets[i] = &graph.getTexture(targets.targets[i]);
+    depthTexture = &graph.getTexture(targets.depth);
+
+    // The framebuffer only has the targets of the layout
+    const auto& framebuffer = targets.numTargets == 2
+        ? graph.getFramebuffer({ targets.targets[0], targets.targets[1] }, targets.depth)
+        : graph.getFramebuffer({ targets.targets[0], targets.targets[1], targets.targets[2] }, targets.depth);
     framebuffer.bind();
-    glViewport(0, 0, (GLsizei)width, (GLsizei)height); gl::checkError();
+    gl::StateCache::viewport(0, 0, (GLsizei)width, (GLsizei)height);
     glClearColor(0.0, 0.0, 0.0, 0.0); gl::checkError();
     glClearDepth(1.0); gl::checkError();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gbufferProgram->setUniform("GBufferLayout", (int)layout);
 }
 
 void GBuffer::end()
@@ -53,14 +57,15 @@ void GBuffer::end()
 void scene::GBuffer::setParams(gl::Program& program, const glm::mat4& projection) const
 {
     // Set the draw parameters
-    colorTexture.bindTo(1);
-    program.setUniform("ColorTexture", 1);
-    depthTexture.bindTo(2);
+    const auto& description = describeGBuffer(layout);
+    for (std::size_t i = 0; i < description.targets.size(); i++)
+    {
+        targets[i]->bindTo(TargetUnits[i]);
+        program.setUniform(gl::UniformName("GBufferTarget" + std::to_string(i)), (int)TargetUnits[i]);
+    }
+    depthTexture->bindTo(2);
     program.setUniform("DepthTexture", 2);
-    normalTexture.bindTo(3);
-    program.setUniform("NormalTexture", 3);
-    specShinyTexture.bindTo(4);
-    program.setUniform("SpecularShininessTexture", 4);
+    program.setUniform("GBufferLayout", (int)layout);
 
     // Set the parameters required for reconstructing the position
     program.setUniform("ScreenSize", glm::vec2(width, height));
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include "wrappers/glfw.hpp"
@@ -7,28 +8,46 @@
 #include "resources/Program.hpp"
 #include "resources/Framebuffer.hpp"
 #include "Lighting.hpp"
+#include "GBufferLayout.hpp"
+#include "FrameGraph.hpp"
 
 namespace scene
 {
+    // The textures of the G-buffer in the frame graph, only as many targets as the layout has
+    struct GBufferTargets
+    {
+        std::array<FrameGraph::Resource, MaxGBufferTargets> targets;
+        std::size_t numTargets;
+        FrameGraph::Resource depth;
+    };
+
     class GBuffer final
     {
-        // Includes all the parameters for a GBuffer
-        gl::Framebuffer framebuffer;
-        gl::Texture2D colorTexture;
-        gl::Texture2D depthTexture;
-        gl::Texture2D normalTexture;
-        gl::Texture2D specShinyTexture;
+        // Includes all the parameters for a GBuffer. The textures are transient textures of the frame graph,
+        // picked up when the G-buffer is drawn, for the passes after it
+        std::array<const gl::Texture2D*, MaxGBufferTargets> targets;
+        const gl::Texture2D* depthTexture;
         std::size_t width, height;
+        GBufferLayout layout;
         std::shared_ptr<gl::Program> gbufferProgram;
 
     public:
-        GBuffer(glfw::Size size);
+        GBuffer(glfw::Size size, GBufferLayout layout = GBufferLayout::Wide);
         ~GBuffer() {}
 
-        void begin();
+        // Declares the textures of the current layout, written by the pass of the builder
+        GBufferTargets createTargets(FrameGraph::Builder& builder) const;
+        void readTargets(FrameGraph::Builder& builder, const GBufferTargets& targets) const;
+
+        void begin(FrameGraph& graph, const GBufferTargets& targets);
         void end();
 
+        // The targets follow the layout from the next frame on
+        void setLayout(GBufferLayout layout) { this->layout = layout; }
+        auto getLayout() const { return layout; }
+
         auto& getDrawProgram() const { return *gbufferProgram; }
+        const gl::Texture2D& getDepthTexture() const { return *depthTexture; }
         void setParams(gl::Program& program, const glm::mat4& projection) const;
     };
-}
\ No newline at end of file
+}
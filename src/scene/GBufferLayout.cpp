@@ -0,0 +1,206 @@
+#include "GBufferLayout.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace scene;
+
+static const GBufferDescription WideLayout
+{
+    "Wide",
+    {
+        { "Color", gl::InternalFormat::RGBA8, 4 },
+        { "Normal", gl::InternalFormat::RG16f, 4 },
+        { "Specular/Shininess", gl::InternalFormat::RG16f, 4 },
+    },
+    {
+        { "color", "", "", { "0r", "0g", "0b" } },
+        // The sign of z goes in the alpha of the color
+        { "normal", "encodeNormalSign", "decodeNormalSign", { "1r", "1g", "0a" } },
+        { "specular", "", "", { "2r" } },
+        { "shininess", "", "", { "2g" } },
+    }
+};
+
+static const GBufferDescription CompactLayout
+{
+    "Compact",
+    {
+        { "Color/Specular", gl::InternalFormat::RGBA8, 4 },
+        { "Normal/Shininess", gl::InternalFormat::RGBA8, 4 },
+    },
+    {
+        { "color", "", "", { "0r", "0g", "0b" } },
+        { "specular", "", "", { "0a" } },
+        // Two 12-bit octahedral coordinates spread over three bytes
+        { "normal", "encodeNormalOctahedral", "decodeNormalOctahedral", { "1r", "1g", "1b" } },
+        { "shininess", "encodeShininess", "decodeShininess", { "1a" } },
+    }
+};
+
+// Both must be in the order of GBufferLayout
+static const GBufferDescription* const Layouts[] = { &WideLayout, &CompactLayout };
+
+const GBufferDescription& scene::describeGBuffer(GBufferLayout layout)
+{
+    return *Layouts[(int)layout];
+}
+
+std::size_t GBufferDescription::bytesPerPixel(std::initializer_list<const char*> names) const
+{
+    std::vector<bool> used(targets.size());
+    for (const auto& attribute : attributes)
+        if (std::any_of(names.begin(), names.end(), [&](const char* name) { return std::string_view(name) == attribute.name; }))
+            for (const auto& channel : attribute.channels) used[channel[0] - '0'] = true;
+
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < targets.size(); i++)
+        if (used[i]) total += targets[i].bytesPerPixel;
+    return total;
+}
+
+std::size_t GBufferDescription::bytesPerPixel() const
+{
+    std::size_t total = 0;
+    for (const auto& target : targets) total += target.bytesPerPixel;
+    return total;
+}
+
+GBufferTraffic scene::measureGBufferTraffic(GBufferLayout layout)
+{
+    // The shaders only keep the fetches of the attributes they use
+    constexpr std::size_t DepthBytes = 4;
+    const auto& description = describeGBuffer(layout);
+    return
+    {
+        description.bytesPerPixel() + DepthBytes,
+        description.bytesPerPixel({ "color", "normal", "shininess" }) + DepthBytes,
+        description.bytesPerPixel({ "normal", "specular", "shininess" }) + DepthBytes,
+        description.bytesPerPixel({ "normal" }) + DepthBytes,
+    };
+}
+
+static std::string vectorType(std::size_t size)
+{
+    return size == 1 ? "float" : "vec" + std::to_string(size);
+}
+
+// The components of the packed vector, or the whole value if it is a scalar
+static std::string component(const GBufferAttribute& attribute, std::size_t i)
+{
+    if (attribute.channels.size() == 1) return "";
+    return std::string(".") + "xyzw"[i];
+}
+
+static bool singleTarget(const GBufferAttribute& attribute)
+{
+    return std::all_of(attribute.channels.begin(), attribute.channels.end(),
+        [&](const std::string& channel) { return channel[0] == attribute.channels[0][0]; });
+}
+
+static std::string swizzle(const GBufferAttribute& attribute)
+{
+    std::string result;
+    for (const auto& channel : attribute.channels) result += channel[1];
+    return result;
+}
+
+static void generateWriter(std::ostream& out, const GBufferDescription& description)
+{
+    for (const auto& attribute : description.attributes)
+    {
+        auto value = std::string("data.") + attribute.name;
+        if (*attribute.encode)
+        {
+            out << "\t\t" << vectorType(attribute.channels.size()) << ' ' << attribute.name << " = " << attribute.encode << '(' << value << ");\n";
+            value = attribute.name;
+        }
+
+        if (singleTarget(attribute))
+            out << "\t\toutGBuffer" << attribute.channels[0][0] << '.' << swizzle(attribute) << " = " << value << ";\n";
+        else for (std::size_t i = 0; i < attribute.channels.size(); i++)
+            out << "\t\toutGBuffer" << attribute.channels[i][0] << '.' << attribute.channels[i][1] << " = " << value << component(attribute, i) << ";\n";
+    }
+}
+
+// Fetches the targets which hold the attributes, then assigns each of them to the destination
+template <typename F>
+static void generateReader(std::ostream& out, const GBufferDescription& description, std::initializer_list<std::string_view> names,
+    F destination)
+{
+    std::vector<const GBufferAttribute*> attributes;
+    std::vector<bool> used(description.targets.size());
+    for (const auto& attribute : description.attributes)
+        if (std::find(names.begin(), names.end(), attribute.name) != names.end())
+        {
+            attributes.push_back(&attribute);
+            for (const auto& channel : attribute.channels) used[channel[0] - '0'] = true;
+        }
+
+    for (std::size_t i = 0; i < used.size(); i++)
+        if (used[i]) out << "\t\tvec4 target" << i << " = texelFetch(GBufferTarget" << i << ", fragCoord, 0);\n";
+
+    for (auto attribute : attributes)
+    {
+        std::string value;
+        if (singleTarget(*attribute)) value = std::string("target") + attribute->channels[0][0] + '.' + swizzle(*attribute);
+        else
+        {
+            value = vectorType(attribute->channels.size()) + '(';
+            for (const auto& channel : attribute->channels)
+                value += std::string(&channel != &attribute->channels.front() ? ", " : "") + "target" + channel[0] + '.' + channel[1];
+            value += ')';
+        }
+
+        if (*attribute->decode) value = std::string(attribute->decode) + '(' + value + ')';
+        out << "\t\t" << destination(attribute->name) << value << ";\n";
+    }
+}
+
+std::string scene::generateGBufferShaderCode()
+{
+    std::ostringstream out;
+    out << "// Generated from the layouts in GBufferLayout.cpp, needs gbufferEncoding.glsl\n\n";
+    out << "uniform int GBufferLayout;\n";
+
+    std::size_t numTargets = 0;
+    for (auto layout : Layouts) numTargets = std::max(numTargets, layout->targets.size());
+    for (std::size_t i = 0; i < numTargets; i++)
+        out << "uniform sampler2D GBufferTarget" << i << ";\n";
+
+    // Every layout writes to the same outputs, the framebuffer drops the ones it does not have
+    out << "\n#ifdef GBUFFER_WRITE\n";
+    for (std::size_t i = 0; i < numTargets; i++)
+        out << "layout(location = " << i << ") out vec4 outGBuffer" << i << ";\n";
+
+    out << "\nvoid writeGbuffer(GBufferData data)\n{\n\tswitch (GBufferLayout)\n\t{\n";
+    for (std::size_t i = 0; i < std::size(Layouts); i++)
+    {
+        out << "\tcase " << i << ": // " << Layouts[i]->name << "\n\t{\n";
+        generateWriter(out, *Layouts[i]);
+        out << "\t\tbreak;\n\t}\n";
+    }
+    out << "\t}\n}\n#endif\n";
+
+    out << "\nvoid readGbufferAttributes(ivec2 fragCoord, inout GBufferData data)\n{\n\tswitch (GBufferLayout)\n\t{\n";
+    for (std::size_t i = 0; i < std::size(Layouts); i++)
+    {
+        out << "\tcase " << i << ": // " << Layouts[i]->name << "\n\t{\n";
+        generateReader(out, *Layouts[i], { "color", "normal", "specular", "shininess" },
+            [](const char* name) { return std::string("data.") + name + " = "; });
+        out << "\t\tbreak;\n\t}\n";
+    }
+    out << "\t}\n}\n";
+
+    // Fetches only the targets holding the normal
+    out << "\nvec3 readNormalFromGbuffer(ivec2 fragCoord)\n{\n\tswitch (GBufferLayout)\n\t{\n";
+    for (std::size_t i = 0; i < std::size(Layouts); i++)
+    {
+        out << "\tcase " << i << ": // " << Layouts[i]->name << "\n\t{\n";
+        generateReader(out, *Layouts[i], { "normal" }, [](const char*) { return std::string("return "); });
+        out << "\t}\n";
+    }
+    out << "\t}\n\treturn vec3(0.0, 0.0, 1.0);\n}\n";
+
+    return out.str();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "resources/TextureFormats.hpp"
+
+namespace scene
+{
+    // Wide keeps the normals and the material in half floats, Compact packs everything in 8 bits per channel
+    enum class GBufferLayout { Wide, Compact };
+
+    constexpr std::size_t MaxGBufferTargets = 3;
+
+    // The name of the generated include which reads and writes the G-buffer
+    constexpr auto GBufferShaderInclude = "gbufferLayout.glsl";
+
+    struct GBufferTarget
+    {
+        const char* name;
+        gl::InternalFormat format;
+        std::size_t bytesPerPixel;
+    };
+
+    // One member of GBufferData. The encoding function of gbufferEncoding.glsl packs it into a vector,
+    // whose components are stored in the given channels, like "0a" for the alpha of the first target,
+    // and the decoding function unpacks it. Without them, it is stored as is
+    struct GBufferAttribute
+    {
+        const char* name;
+        const char* encode;
+        const char* decode;
+        std::vector<std::string> channels;
+    };
+
+    struct GBufferDescription
+    {
+        const char* name;
+        std::vector<GBufferTarget> targets;
+        std::vector<GBufferAttribute> attributes;
+
+        // The bytes fetched or written for the targets holding any of the given attributes, without the depth
+        std::size_t bytesPerPixel(std::initializer_list<const char*> attributes) const;
+        std::size_t bytesPerPixel() const;
+    };
+
+    const GBufferDescription& describeGBuffer(GBufferLayout layout);
+
+    // The GLSL code which writes and reads every layout from its description, picked by the GBufferLayout uniform
+    std::string generateGBufferShaderCode();
+
+    // The G-buffer bytes per pixel of the passes which touch it, including the depth
+    struct GBufferTraffic
+    {
+        std::size_t written;        // Building it
+        std::size_t resolveRead;    // Resolving the lighting, and shading the local lights
+        std::size_t ssrRead;        // Tracing each reflection
+        std::size_t ssrNormalRead;  // Each tap of the reflection upsampling
+    };
+
+    GBufferTraffic measureGBufferTraffic(GBufferLayout layout);
+}
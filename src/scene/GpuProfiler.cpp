@@ -0,0 +1,77 @@
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+
+using namespace scene;
+
+void GpuProfiler::beginFrame()
+{
+    auto& frame = frames[currentFrame];
+    if (frame.pending) droppedFrames++;
+
+    // The queries stay allocated, so they are only created for the frames with more zones than ever before
+    frame.usedQueries = 0;
+    frame.markers.clear();
+    frame.pending = false;
+    depth = 0;
+}
+
+void GpuProfiler::endFrame()
+{
+    auto& frame = frames[currentFrame];
+    frame.pending = !frame.markers.empty();
+    currentFrame = (currentFrame + 1) % FramesInFlight;
+}
+
+std::size_t GpuProfiler::writeTimestamp()
+{
+    auto& frame = frames[currentFrame];
+    if (frame.usedQueries == frame.queries.size()) frame.queries.emplace_back(gl::QueryType::Timestamp);
+    frame.queries[frame.usedQueries].queryCounter();
+    return frame.usedQueries++;
+}
+
+std::size_t GpuProfiler::begin(std::string name)
+{
+    auto& markers = frames[currentFrame].markers;
+    markers.push_back({ std::move(name), depth++, writeTimestamp(), 0 });
+    return markers.size() - 1;
+}
+
+void GpuProfiler::end(std::size_t marker)
+{
+    frames[currentFrame].markers[marker].end = writeTimestamp();
+    depth--;
+}
+
+void GpuProfiler::collect()
+{
+    // The next frame to write is also the oldest one
+    for (std::size_t i = 0; i < FramesInFlight; i++)
+    {
+        auto& frame = frames[(currentFrame + i) % FramesInFlight];
+        if (!frame.pending) continue;
+
+        // The timestamps are written in order, so the last one comes after all the others
+        if (!frame.queries[frame.usedQueries - 1].available()) break;
+
+        lastZones.clear();
+        for (const auto& marker : frame.markers)
+            lastZones.push_back({ marker.name, marker.depth, frame.queries[marker.end].result() - frame.queries[marker.begin].result() });
+        frame.pending = false;
+    }
+}
+
+GLuint64 GpuProfiler::getLastTime(std::string_view name) const
+{
+    auto it = std::ranges::find(lastZones, name, &Zone::name);
+    return it != lastZones.end() ? it->time : 0;
+}
+
+GLuint64 GpuProfiler::getLastTotal() const
+{
+    GLuint64 total = 0;
+    for (const auto& zone : lastZones)
+        if (zone.depth == 0) total += zone.time;
+    return total;
+}
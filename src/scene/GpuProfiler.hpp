@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "resources/Query.hpp"
+
+namespace scene
+{
+    // Times nested zones of each frame on the GPU with timestamps. Every frame in flight has its own queries,
+    // which are kept and reused, and its results are read back a few frames later, once they are all available,
+    // so reading them never waits for the GPU
+    class GpuProfiler final
+    {
+    public:
+        static constexpr std::size_t FramesInFlight = 3;
+
+        struct Zone
+        {
+            std::string name;
+            std::size_t depth;
+            GLuint64 time;
+        };
+
+        // Times a zone until it goes out of scope, inside the zones still open
+        class Scope final
+        {
+            GpuProfiler& profiler;
+            std::size_t marker;
+
+        public:
+            Scope(GpuProfiler& profiler, std::string name) : profiler(profiler), marker(profiler.begin(std::move(name))) {}
+            ~Scope() { profiler.end(marker); }
+
+            // Disallow copying
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        };
+
+    private:
+        struct Marker
+        {
+            std::string name;
+            std::size_t depth, begin, end;
+        };
+
+        struct Frame
+        {
+            std::vector<gl::Query> queries;
+            std::size_t usedQueries = 0;
+            std::vector<Marker> markers;
+            bool pending = false;
+        };
+
+        std::array<Frame, FramesInFlight> frames;
+        std::size_t currentFrame;
+        std::size_t depth;
+        std::vector<Zone> lastZones;
+        std::size_t droppedFrames;
+
+        std::size_t begin(std::string name);
+        void end(std::size_t marker);
+        std::size_t writeTimestamp();
+
+    public:
+        GpuProfiler() : currentFrame(0), depth(0), droppedFrames(0) {}
+
+        // A frame whose results are still not available when its queries are needed again is dropped
+        void beginFrame();
+        void endFrame();
+
+        Scope scope(std::string name) { return Scope(*this, std::move(name)); }
+
+        // Reads back the frames whose results are available, the oldest first
+        void collect();
+
+        // The zones of the last frame read back, in the order they began
+        const std::vector<Zone>& getLastZones() const { return lastZones; }
+
+        // The time of the first zone with the name in the last frame, or zero if it did not have one
+        GLuint64 getLastTime(std::string_view name) const;
+
+        // The time of the outermost zones, which do not overlap
+        GLuint64 getLastTotal() const;
+
+        std::size_t getDroppedFrames() const { return droppedFrames; }
+    };
+}
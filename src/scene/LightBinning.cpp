@@ -0,0 +1,85 @@
+#include "LightBinning.hpp"
+
+#include <algorithm>
+
+using namespace scene;
+
+static glm::vec3 unproject(const glm::mat4& inverseProjection, float x, float y, float depth)
+{
+    auto pos = inverseProjection * glm::vec4(x, y, 2.0f * depth - 1.0f, 1.0f);
+    return glm::vec3(pos) / pos.w;
+}
+
+std::array<glm::vec3, 4> scene::tilePlanes(int tx, int ty, int width, int height, const glm::mat4& inverseProjection)
+{
+    // The corners of the tile in normalized device coordinates, clipped to the screen
+    auto x0 = 2.0f * float(tx * LightTileSize) / float(width) - 1.0f;
+    auto x1 = 2.0f * float(std::min((tx + 1) * LightTileSize, width)) / float(width) - 1.0f;
+    auto y0 = 2.0f * float(ty * LightTileSize) / float(height) - 1.0f;
+    auto y1 = 2.0f * float(std::min((ty + 1) * LightTileSize, height)) / float(height) - 1.0f;
+
+    // The planes go through the eye, so two points on the far plane are enough for each
+    auto bottomLeft = unproject(inverseProjection, x0, y0, 1.0f);
+    auto bottomRight = unproject(inverseProjection, x1, y0, 1.0f);
+    auto topLeft = unproject(inverseProjection, x0, y1, 1.0f);
+    auto topRight = unproject(inverseProjection, x1, y1, 1.0f);
+
+    return
+    {
+        glm::normalize(glm::cross(bottomLeft, topLeft)),
+        glm::normalize(glm::cross(topRight, bottomRight)),
+        glm::normalize(glm::cross(bottomRight, bottomLeft)),
+        glm::normalize(glm::cross(topLeft, topRight))
+    };
+}
+
+bool scene::sphereInTile(const LightSphere& light, const std::array<glm::vec3, 4>& planes, float nearZ, float farZ)
+{
+    if (light.center.z - light.radius > nearZ || light.center.z + light.radius < farZ) return false;
+
+    for (const auto& plane : planes)
+        if (glm::dot(plane, light.center) < -light.radius) return false;
+
+    return true;
+}
+
+LightTiles scene::binLights(std::span<const LightSphere> lights, std::span<const float> depth, int width, int height,
+    const glm::mat4& projection)
+{
+    auto inverseProjection = glm::inverse(projection);
+    LightTiles tiles((width + LightTileSize - 1) / LightTileSize, (height + LightTileSize - 1) / LightTileSize);
+
+    for (int ty = 0; ty < tiles.tilesY; ty++)
+        for (int tx = 0; tx < tiles.tilesX; tx++)
+        {
+            // The depth range of the tile, leaving out the background
+            float minDepth = 1.0f, maxDepth = 0.0f;
+            for (int y = ty * LightTileSize; y < std::min((ty + 1) * LightTileSize, height); y++)
+                for (int x = tx * LightTileSize; x < std::min((tx + 1) * LightTileSize, width); x++)
+                {
+                    auto d = depth[std::size_t(y) * width + x];
+                    if (d >= 1.0f) continue;
+                    minDepth = std::min(minDepth, d);
+                    maxDepth = std::max(maxDepth, d);
+                }
+
+            // Nothing to light here
+            if (minDepth > maxDepth) continue;
+
+            auto nearZ = unproject(inverseProjection, 0.0f, 0.0f, minDepth).z;
+            auto farZ = unproject(inverseProjection, 0.0f, 0.0f, maxDepth).z;
+            auto planes = tilePlanes(tx, ty, width, height, inverseProjection);
+
+            auto tile = tiles.data.begin() + (std::size_t(ty) * tiles.tilesX + tx) * LightTiles::TileStride;
+            std::uint32_t count = 0;
+            for (std::uint32_t i = 0; i < lights.size(); i++)
+                if (sphereInTile(lights[i], planes, nearZ, farZ))
+                {
+                    if (count < MaxLightsPerTile) tile[1 + count] = i;
+                    count++;
+                }
+            tile[0] = count;
+        }
+
+    return tiles;
+}
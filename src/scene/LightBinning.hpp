@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace scene
+{
+    // Both must match the constants in tiledLighting.comp
+    constexpr int LightTileSize = 16;
+    constexpr std::uint32_t MaxLightsPerTile = 256;
+
+    // The bounding sphere of a light, in view space
+    struct LightSphere
+    {
+        glm::vec3 center;
+        float radius;
+    };
+
+    // The lights of each tile, laid out like the buffer the compute shader writes:
+    // every tile has its light count followed by room for MaxLightsPerTile indices
+    struct LightTiles
+    {
+        static constexpr std::size_t TileStride = MaxLightsPerTile + 1;
+
+        int tilesX, tilesY;
+        std::vector<std::uint32_t> data;
+
+        LightTiles(int tilesX, int tilesY) : tilesX(tilesX), tilesY(tilesY), data(std::size_t(tilesX) * tilesY * TileStride) {}
+
+        std::uint32_t count(int tx, int ty) const { return data[(std::size_t(ty) * tilesX + tx) * TileStride]; }
+        std::span<const std::uint32_t> lights(int tx, int ty) const
+        {
+            auto first = data.data() + (std::size_t(ty) * tilesX + tx) * TileStride + 1;
+            return { first, std::min(count(tx, ty), MaxLightsPerTile) };
+        }
+    };
+
+    // The side planes of the frustum of a tile in view space, pointing inwards, in the order left, right, bottom, top
+    std::array<glm::vec3, 4> tilePlanes(int tx, int ty, int width, int height, const glm::mat4& inverseProjection);
+
+    // The tile spans the view space depths [farZ, nearZ], both negative
+    bool sphereInTile(const LightSphere& light, const std::array<glm::vec3, 4>& planes, float nearZ, float farZ);
+
+    // CPU reference of the binning done by the tiled lighting compute shader, which can run without a GPU.
+    // The depth buffer is stored row by row starting from the bottom, like OpenGL reads it back
+    LightTiles binLights(std::span<const LightSphere> lights, std::span<const float> depth, int width, int height,
+        const glm::mat4& projection);
+}
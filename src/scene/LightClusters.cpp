@@ -0,0 +1,242 @@
+#include "LightClusters.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define CLUSTER_SIMD
+#endif
+
+using namespace scene;
+
+static glm::vec3 unproject(const glm::mat4& inverseProjection, float x, float y, float depth)
+{
+    auto pos = inverseProjection * glm::vec4(x, y, 2.0f * depth - 1.0f, 1.0f);
+    return glm::vec3(pos) / pos.w;
+}
+
+// The distance of a point to a box along one axis, zero inside it
+static float axisDistance(float center, float min, float max)
+{
+    return std::max(std::max(min - center, center - max), 0.0f);
+}
+
+// The SIMD paths do the same operations in the same order, so all the versions give the same clusters
+static bool sphereIntersectsAABB(float x, float y, float z, float radiusSquared, const util::AABBList& bounds, std::size_t i)
+{
+    auto dx = axisDistance(x, bounds.minX[i], bounds.maxX[i]);
+    auto dy = axisDistance(y, bounds.minY[i], bounds.maxY[i]);
+    auto dz = axisDistance(z, bounds.minZ[i], bounds.maxZ[i]);
+    return dx * dx + dy * dy + dz * dz <= radiusSquared;
+}
+
+LightClusterBuilder::LightClusterBuilder(unsigned numWorkers) : projection(0.0f), zNear(0), zFar(0),
+    numWorkers(numWorkers != 0 ? numWorkers : std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+void LightClusterBuilder::setProjection(const glm::mat4& projection)
+{
+    if (projection == this->projection) return;
+    this->projection = projection;
+
+    // Recover the clipping planes from the perspective matrix
+    zNear = projection[3][2] / (projection[2][2] - 1.0f);
+    zFar = projection[3][2] / (projection[2][2] + 1.0f);
+
+    auto inverseProjection = glm::inverse(projection);
+    bounds = util::AABBList();
+    for (int z = 0; z < ClusterSlices; z++)
+    {
+        // The slices are bounded by planes of constant view space depth, so their z extents are exact
+        auto sliceNear = -zNear * std::pow(zFar / zNear, float(z) / ClusterSlices);
+        auto sliceFar = -zNear * std::pow(zFar / zNear, float(z + 1) / ClusterSlices);
+
+        for (int y = 0; y < ClusterTilesY; y++)
+            for (int x = 0; x < ClusterTilesX; x++)
+            {
+                auto x0 = 2.0f * float(x) / ClusterTilesX - 1.0f, x1 = 2.0f * float(x + 1) / ClusterTilesX - 1.0f;
+                auto y0 = 2.0f * float(y) / ClusterTilesY - 1.0f, y1 = 2.0f * float(y + 1) / ClusterTilesY - 1.0f;
+                glm::vec3 corners[] =
+                {
+                    unproject(inverseProjection, x0, y0, 1.0f), unproject(inverseProjection, x1, y0, 1.0f),
+                    unproject(inverseProjection, x0, y1, 1.0f), unproject(inverseProjection, x1, y1, 1.0f)
+                };
+
+                // Where the rays through the corners of the tile cross both planes of the slice
+                auto min = glm::vec3(INFINITY), max = glm::vec3(-INFINITY);
+                for (const auto& corner : corners)
+                    for (auto depth : { sliceNear, sliceFar })
+                    {
+                        auto point = corner * (depth / corner.z);
+                        min = glm::min(min, point);
+                        max = glm::max(max, point);
+                    }
+
+                bounds.push_back(glm::vec3(min.x, min.y, sliceFar), glm::vec3(max.x, max.y, sliceNear));
+            }
+    }
+}
+
+float LightClusterBuilder::getSliceScale() const
+{
+    return ClusterSlices / std::log(zFar / zNear);
+}
+
+float LightClusterBuilder::getSliceBias() const
+{
+    return -std::log(zNear) * getSliceScale();
+}
+
+LightClusters LightClusterBuilder::assignLightsScalar(std::span<const LightSphere> lights) const
+{
+    LightClusters clusters;
+    clusters.ranges.resize(NumClusters);
+
+    for (std::size_t i = 0; i < NumClusters; i++)
+    {
+        clusters.ranges[i].x = (std::uint32_t)clusters.indices.size();
+        for (std::uint32_t j = 0; j < lights.size(); j++)
+        {
+            const auto& light = lights[j];
+            if (sphereIntersectsAABB(light.center.x, light.center.y, light.center.z, light.radius * light.radius, bounds, i))
+                clusters.indices.push_back(j);
+        }
+        clusters.ranges[i].y = (std::uint32_t)clusters.indices.size() - clusters.ranges[i].x;
+    }
+
+    return clusters;
+}
+
+// The lights which reach the depth range of a slice, laid out as structure of arrays
+struct SliceLights
+{
+    std::vector<float> x, y, z, radiusSquared;
+    std::vector<std::uint32_t> index;
+};
+
+void LightClusterBuilder::assignSlice(int slice, std::span<const LightSphere> lights, std::vector<std::uint32_t>& indices,
+    std::vector<glm::uvec2>& ranges) const
+{
+    // All the clusters of the slice share its depth range, so most lights can be left out up front
+    auto first = LightClusters::clusterIndex(0, 0, slice);
+    SliceLights candidates;
+    for (std::uint32_t j = 0; j < lights.size(); j++)
+    {
+        const auto& light = lights[j];
+        auto dz = axisDistance(light.center.z, bounds.minZ[first], bounds.maxZ[first]);
+        auto radiusSquared = light.radius * light.radius;
+        if (dz * dz > radiusSquared) continue;
+
+        candidates.x.push_back(light.center.x);
+        candidates.y.push_back(light.center.y);
+        candidates.z.push_back(light.center.z);
+        candidates.radiusSquared.push_back(radiusSquared);
+        candidates.index.push_back(j);
+    }
+
+    auto count = candidates.index.size();
+    for (auto i = first; i < first + std::size_t(ClusterTilesX) * ClusterTilesY; i++)
+    {
+        // The offsets are relative to the slice until all of them are merged
+        ranges[i].x = (std::uint32_t)indices.size();
+        std::size_t j = 0;
+
+        // Appends the lights whose bits are set in the mask
+        auto appendMask = [&](std::size_t base, int mask)
+        {
+            for (; mask != 0; mask &= mask - 1)
+                indices.push_back(candidates.index[base + std::countr_zero((unsigned)mask)]);
+        };
+
+#ifdef CLUSTER_SIMD
+#ifdef __AVX__
+        {
+            auto minX = _mm256_set1_ps(bounds.minX[i]), maxX = _mm256_set1_ps(bounds.maxX[i]);
+            auto minY = _mm256_set1_ps(bounds.minY[i]), maxY = _mm256_set1_ps(bounds.maxY[i]);
+            auto minZ = _mm256_set1_ps(bounds.minZ[i]), maxZ = _mm256_set1_ps(bounds.maxZ[i]);
+            auto axisDistance = [](__m256 center, __m256 min, __m256 max)
+            {
+                return _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(min, center), _mm256_sub_ps(center, max)), _mm256_setzero_ps());
+            };
+
+            for (; j + 8 <= count; j += 8)
+            {
+                auto dx = axisDistance(_mm256_loadu_ps(candidates.x.data() + j), minX, maxX);
+                auto dy = axisDistance(_mm256_loadu_ps(candidates.y.data() + j), minY, maxY);
+                auto dz = axisDistance(_mm256_loadu_ps(candidates.z.data() + j), minZ, maxZ);
+                auto distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+                auto radiusSquared = _mm256_loadu_ps(candidates.radiusSquared.data() + j);
+                appendMask(j, _mm256_movemask_ps(_mm256_cmp_ps(distance, radiusSquared, _CMP_LE_OQ)));
+            }
+        }
+#endif
+        {
+            auto minX = _mm_set1_ps(bounds.minX[i]), maxX = _mm_set1_ps(bounds.maxX[i]);
+            auto minY = _mm_set1_ps(bounds.minY[i]), maxY = _mm_set1_ps(bounds.maxY[i]);
+            auto minZ = _mm_set1_ps(bounds.minZ[i]), maxZ = _mm_set1_ps(bounds.maxZ[i]);
+            auto axisDistance = [](__m128 center, __m128 min, __m128 max)
+            {
+                return _mm_max_ps(_mm_max_ps(_mm_sub_ps(min, center), _mm_sub_ps(center, max)), _mm_setzero_ps());
+            };
+
+            for (; j + 4 <= count; j += 4)
+            {
+                auto dx = axisDistance(_mm_loadu_ps(candidates.x.data() + j), minX, maxX);
+                auto dy = axisDistance(_mm_loadu_ps(candidates.y.data() + j), minY, maxY);
+                auto dz = axisDistance(_mm_loadu_ps(candidates.z.data() + j), minZ, maxZ);
+                auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                auto radiusSquared = _mm_loadu_ps(candidates.radiusSquared.data() + j);
+                appendMask(j, _mm_movemask_ps(_mm_cmple_ps(distance, radiusSquared)));
+            }
+        }
+#endif
+        for (; j < count; j++)
+            if (sphereIntersectsAABB(candidates.x[j], candidates.y[j], candidates.z[j], candidates.radiusSquared[j], bounds, i))
+                indices.push_back(candidates.index[j]);
+
+        ranges[i].y = (std::uint32_t)indices.size() - ranges[i].x;
+    }
+}
+
+LightClusters LightClusterBuilder::assignLights(std::span<const LightSphere> lights, unsigned workers) const
+{
+    LightClusters clusters;
+    clusters.ranges.resize(NumClusters);
+    std::vector<std::vector<std::uint32_t>> sliceIndices(ClusterSlices);
+
+    // The slices near the camera are small and hold few lights, so interleave them to even out the work
+    auto work = [&](unsigned worker, unsigned numWorkers)
+    {
+        for (int slice = worker; slice < ClusterSlices; slice += numWorkers)
+            assignSlice(slice, lights, sliceIndices[slice], clusters.ranges);
+    };
+
+    workers = std::clamp(workers, 1u, (unsigned)ClusterSlices);
+    if (workers == 1) work(0, 1);
+    else
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(workers - 1);
+        for (unsigned worker = 1; worker < workers; worker++)
+            threads.emplace_back(work, worker, workers);
+        work(0, workers);
+    }
+
+    // Join the lists of the slices, in order
+    std::size_t total = 0;
+    for (const auto& indices : sliceIndices) total += indices.size();
+    clusters.indices.reserve(total);
+
+    for (int slice = 0; slice < ClusterSlices; slice++)
+    {
+        auto base = (std::uint32_t)clusters.indices.size();
+        auto first = LightClusters::clusterIndex(0, 0, slice);
+        for (auto i = first; i < first + std::size_t(ClusterTilesX) * ClusterTilesY; i++)
+            clusters.ranges[i].x += base;
+        clusters.indices.insert(clusters.indices.end(), sliceIndices[slice].begin(), sliceIndices[slice].end());
+    }
+
+    return clusters;
+}
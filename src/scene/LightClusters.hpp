@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include "LightBinning.hpp"
+#include "util/Frustum.hpp"
+
+namespace scene
+{
+    // All must match the constants in localLights.glsl
+    constexpr int ClusterTilesX = 32;
+    constexpr int ClusterTilesY = 18;
+    constexpr int ClusterSlices = 24;
+    constexpr std::size_t NumClusters = std::size_t(ClusterTilesX) * ClusterTilesY * ClusterSlices;
+
+    // The lights of each cluster as a range of one shared index list, laid out like the buffers resolve.frag reads.
+    // The clusters are numbered row by row, then slice by slice
+    struct LightClusters
+    {
+        std::vector<glm::uvec2> ranges; // offset and count
+        std::vector<std::uint32_t> indices;
+
+        static std::size_t clusterIndex(int x, int y, int z) { return (std::size_t(z) * ClusterTilesY + y) * ClusterTilesX + x; }
+
+        std::span<const std::uint32_t> lights(int x, int y, int z) const
+        {
+            auto range = ranges[clusterIndex(x, y, z)];
+            return { indices.data() + range.x, range.y };
+        }
+    };
+
+    // Slices the view frustum into a grid of screen tiles and depth slices, which grow exponentially
+    // with the distance so all the clusters have roughly the same proportions, and assigns the lights
+    // to them on the CPU
+    class LightClusterBuilder final
+    {
+        glm::mat4 projection;
+        float zNear, zFar;
+
+        // The view space bounds of every cluster
+        util::AABBList bounds;
+        unsigned numWorkers;
+
+        void assignSlice(int slice, std::span<const LightSphere> lights, std::vector<std::uint32_t>& indices,
+            std::vector<glm::uvec2>& ranges) const;
+
+    public:
+        // Zero workers uses one per hardware thread
+        LightClusterBuilder(unsigned numWorkers = 0);
+
+        // Only rebuilds the cluster bounds when the projection changes
+        void setProjection(const glm::mat4& projection);
+
+        // The slice of a view space depth z is floor(log(-z) * scale + bias)
+        float getSliceScale() const;
+        float getSliceBias() const;
+
+        // Reference version, one light and one cluster at a time on the calling thread
+        LightClusters assignLightsScalar(std::span<const LightSphere> lights) const;
+
+        // Tests the lights against each cluster in SIMD batches, with the slices spread over the workers
+        LightClusters assignLights(std::span<const LightSphere> lights) const { return assignLights(lights, numWorkers); }
+        LightClusters assignLights(std::span<const LightSphere> lights, unsigned workers) const;
+    };
+}
@@ -1,81 +1,179 @@
 #include "Lighting.hpp"
 
+#include "GBuffer.hpp"
 #include "resources/Cache.hpp"
 #include <glm/gtx/transform.hpp>
+#include <chrono>
+#include <algorithm>
 
 using namespace scene;
 
-constexpr float Edge = 16;
+constexpr float CascadeSplitBlend = 0.75f;
+constexpr float DepthMargin = 1.0f;
+const glm::vec3 MaterialSpecularColor(0.5, 0.5, 0.5);
 
-Lighting::Lighting(float xmin, float ymin, float zmin, float xmax, float ymax, float zmax, float resolution,
-    glm::vec3 lightDirection) : lightDirection(lightDirection)
+// Laid out as the std430 struct in tiledLighting.comp
+struct GpuLight
 {
+    glm::vec4 positionRadius;
+    glm::vec4 colorCosOuter;
+    glm::vec4 directionCosInner;
+};
+
+Lighting::Lighting(float xmin, float ymin, float zmin, float xmax, float ymax, float zmax, GLsizei cascadeSize, float shadowDistance,
+    glm::vec3 lightDirection) : lightDirection(lightDirection), lightData(), tilesX(0), tilesY(0), clustered(false), clusterData(),
+    clusterIndexData(), lastClusterTime(0)
+{
+    shadowMap.size = cascadeSize;
+    shadowMap.distance = shadowDistance;
+    shadowMap.viewProjections.resize(NumShadowCascades);
+    shadowMap.splits.resize(NumShadowCascades);
+    shadowMap.texelSizes.resize(NumShadowCascades);
+    shadowMap.drawnViewProjections.resize(NumShadowCascades);
+
+    shadowMap.boundsMin = glm::vec3(xmin, ymin, zmin);
+    shadowMap.boundsMax = glm::vec3(xmax, ymax, zmax);
+    setLightDirection(lightDirection);
+
+    // Create the depth texture, its size does not depend on the scene anymore
+    shadowMap.depthTexture.storage(1, gl::InternalFormat::Depth32f, cascadeSize, cascadeSize, NumShadowCascades);
+    shadowMap.depthTexture.setMagFilter(gl::MagFilter::Linear);
+    shadowMap.depthTexture.setMinFilter(gl::MinFilter::Linear);
+    shadowMap.depthTexture.setWrapEffectS(gl::WrapEffect::ClampToEdge);
+    shadowMap.depthTexture.setWrapEffectT(gl::WrapEffect::ClampToEdge);
+    shadowMap.depthTexture.enableComparisonMode();
+    shadowMap.depthTexture.setName("Shadow Depth Texture");
+
+    // And attach each layer to its framebuffer
+    shadowMap.framebuffers.resize(NumShadowCascades);
+    for (int i = 0; i < NumShadowCascades; i++)
+    {
+        auto& framebuffer = shadowMap.framebuffers[i];
+        framebuffer.attachLayer(gl::DepthAttachment, shadowMap.depthTexture, 0, i);
+        framebuffer.setName("Shadow Framebuffer " + std::to_string(i));
+
+        // Tell OpenGL not to draw anything to color
+        framebuffer.disableColorBuffers();
+    }
+
+    tileBuffer.setName("Light Tile Buffer");
+    tiledLightingProgram = cache::loadProgram({ "resources/shaders/tiledLighting.comp" });
+}
+
+void Lighting::setLightDirection(glm::vec3 direction)
+{
+    lightDirection = direction;
+
     // Load the view
-    auto view = glm::lookAtRH(glm::vec3(0, 0, 0), lightDirection, glm::vec3(0, 1, 0));
+    shadowMap.lightView = glm::lookAtRH(glm::vec3(0, 0, 0), lightDirection, glm::vec3(0, 1, 0));
 
     // Get the min and max extents
+    const auto& min = shadowMap.boundsMin;
+    const auto& max = shadowMap.boundsMax;
     glm::vec4 points[8];
-    points[0] = glm::vec4(xmin, ymin, zmin, 1);
-    points[1] = glm::vec4(xmax, ymin, zmin, 1);
-    points[2] = glm::vec4(xmin, ymax, zmin, 1);
-    points[3] = glm::vec4(xmax, ymax, zmin, 1);
-    points[4] = glm::vec4(xmin, ymin, zmax, 1);
-    points[5] = glm::vec4(xmax, ymin, zmax, 1);
-    points[6] = glm::vec4(xmin, ymax, zmax, 1);
-    points[7] = glm::vec4(xmax, ymax, zmax, 1);
-
-    glm::vec3 min = view * points[0], max = view * points[0];
+    points[0] = glm::vec4(min.x, min.y, min.z, 1);
+    points[1] = glm::vec4(max.x, min.y, min.z, 1);
+    points[2] = glm::vec4(min.x, max.y, min.z, 1);
+    points[3] = glm::vec4(max.x, max.y, min.z, 1);
+    points[4] = glm::vec4(min.x, min.y, max.z, 1);
+    points[5] = glm::vec4(max.x, min.y, max.z, 1);
+    points[6] = glm::vec4(min.x, max.y, max.z, 1);
+    points[7] = glm::vec4(max.x, max.y, max.z, 1);
+
+    shadowMap.sceneMin = shadowMap.sceneMax = shadowMap.lightView * points[0];
     for (std::size_t i = 1; i < 8; i++)
     {
-        auto vec = view * points[i];
+        auto vec = glm::vec3(shadowMap.lightView * points[i]);
+        shadowMap.sceneMin = glm::min(shadowMap.sceneMin, vec);
+        shadowMap.sceneMax = glm::max(shadowMap.sceneMax, vec);
+    }
+
+    invalidateShadows();
+}
+
+void Lighting::invalidateShadows()
+{
+    // No cascade can have a zero projection
+    std::ranges::fill(shadowMap.drawnViewProjections, glm::mat4(0.0f));
+}
 
-        min.x = std::min(min.x, vec.x);
-        min.y = std::min(min.y, vec.y);
-        min.z = std::min(min.z, vec.z);
+bool Lighting::needsShadowUpdate(int cascade) const
+{
+    return shadowMap.drawnViewProjections[cascade] != shadowMap.viewProjections[cascade];
+}
+
+void Lighting::fitShadowCascades(const glm::mat4& projection, const glm::mat4& view)
+{
+    // Recover the clipping planes from the perspective matrix
+    auto zNear = projection[3][2] / (projection[2][2] - 1.0f);
+    auto zFar = std::min(projection[3][2] / (projection[2][2] + 1.0f), shadowMap.distance);
 
-        max.x = std::max(max.x, vec.x);
-        max.y = std::max(max.y, vec.y);
-        max.z = std::max(max.z, vec.z);
+    // The rays through the corners of the screen, scaled to a view space depth of one
+    auto inverseProjection = glm::inverse(projection);
+    glm::vec3 rays[4];
+    for (int i = 0; i < 4; i++)
+    {
+        auto corner = inverseProjection * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, 1.0f, 1.0f);
+        rays[i] = glm::vec3(corner) / -corner.z;
     }
 
-    // Generate the orthographic projection
-    auto er = Edge * resolution;
-    auto proj = glm::ortho(min.x - er, max.x + er, min.y - er, max.x + er, min.z - er, max.z + er);
-    shadowMap.viewProjection = proj * view;
+    auto viewToLight = shadowMap.lightView * glm::inverse(view);
+    auto cascadeNear = zNear;
+    for (int i = 0; i < NumShadowCascades; i++)
+    {
+        // Blend the logarithmic and the uniform splits, the first alone leaves the last cascades too long
+        auto t = float(i + 1) / NumShadowCascades;
+        auto cascadeFar = glm::mix(zNear + (zFar - zNear) * t, zNear * std::pow(zFar / zNear, t), CascadeSplitBlend);
+        shadowMap.splits[i] = cascadeFar;
 
-    // Create the depth texture
-    shadowMap.width = (GLsizei)std::ceil((max.x - min.x) / resolution + 2 * Edge);
-    shadowMap.height = (GLsizei)std::ceil((max.y - min.y) / resolution + 2 * Edge);
-    shadowMap.depthTexture.assign(0, gl::InternalFormat::Depth32f, shadowMap.width, shadowMap.height);
-    shadowMap.depthTexture.setMagFilter(gl::MagFilter::Linear);
-    shadowMap.depthTexture.setMinFilter(gl::MinFilter::Linear);
-    shadowMap.depthTexture.enableComparisonMode();
-    shadowMap.depthTexture.setName("Shadow Depth Texture");
+        // Bound the slice of the frustum by a sphere, so the size of the cascade does not change when the camera turns
+        glm::vec3 corners[8];
+        auto center = glm::vec3(0.0f);
+        for (int j = 0; j < 8; j++)
+        {
+            corners[j] = glm::vec3(viewToLight * glm::vec4(rays[j & 3] * (j < 4 ? cascadeNear : cascadeFar), 1.0f));
+            center += corners[j] / 8.0f;
+        }
 
-    // And attach it to the framebuffer
-    shadowMap.framebuffer.attach(gl::DepthAttachment, shadowMap.depthTexture);
-    shadowMap.framebuffer.setName("Shadow Framebuffer");
+        auto radius = 0.0f;
+        for (const auto& corner : corners) radius = std::max(radius, glm::distance(corner, center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
 
-    // Tell OpenGL not to draw anything to color
-    shadowMap.framebuffer.bind();
-    glDrawBuffer(GL_NONE); gl::checkError();
-    glReadBuffer(GL_NONE); gl::checkError();
-    gl::Framebuffer::bindDefault();
+        // Move the cascade in whole texels only, otherwise the shadow edges crawl as the camera moves
+        auto texelSize = 2.0f * radius / shadowMap.size;
+        center.x = std::floor(center.x / texelSize) * texelSize;
+        center.y = std::floor(center.y / texelSize) * texelSize;
+        shadowMap.texelSizes[i] = texelSize;
+
+        // The depth range takes the whole scene, so casters outside the slice still cast their shadows into it
+        auto proj = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+            -shadowMap.sceneMax.z - DepthMargin, -shadowMap.sceneMin.z + DepthMargin);
+        shadowMap.viewProjections[i] = proj * shadowMap.lightView;
+
+        cascadeNear = cascadeFar;
+    }
 }
 
-glm::mat4 Lighting::getShadowProjection() const
+glm::mat4 Lighting::getShadowProjection(int cascade) const
 {
-    return shadowMap.viewProjection;
+    return shadowMap.viewProjections[cascade];
 }
 
 void Lighting::setLightParams(gl::Program& program, const glm::mat4& view) const
 {
-    program.setUniform("Material.specularColor", glm::vec3(0.5, 0.5, 0.5));
+    program.setUniform("Material.specularColor", MaterialSpecularColor);
     program.setUniform("Light.ambient", glm::vec3(0.25, 0.25, 0.25));
     program.setUniform("Light.diffuse", glm::vec3(0.625, 0.625, 0.625));
     program.setUniform("Light.specular", glm::vec3(1.0, 1.0, 1.0));
     program.setUniform("Light.directionView", glm::normalize(glm::mat3(view) * lightDirection));
-    program.setUniform("ShadowViewProjection", shadowMap.viewProjection);
+
+    // The resolve pass works in view space
+    auto inverseView = glm::inverse(view);
+    std::vector<glm::mat4> viewProjections;
+    for (const auto& viewProjection : shadowMap.viewProjections) viewProjections.push_back(viewProjection * inverseView);
+    program.setUniform("ShadowViewProjections", viewProjections);
+    program.setUniform("ShadowCascadeSplits", shadowMap.splits);
+    program.setUniform("ShadowTexelSizes", shadowMap.texelSizes);
 }
 
 void scene::Lighting::setShadowMapTexture(gl::Program& program) const
@@ -84,10 +182,11 @@ void scene::Lighting::setShadowMapTexture(gl::Program& program) const
     program.setUniform("ShadowMapTexture", 5);
 }
 
-void Lighting::beginShadow()
+void Lighting::beginShadow(int cascade)
 {
-    shadowMap.framebuffer.bind();
-    glViewport(0, 0, shadowMap.width, shadowMap.height);
+    shadowMap.drawnViewProjections[cascade] = shadowMap.viewProjections[cascade];
+    shadowMap.framebuffers[cascade].bind();
+    gl::StateCache::viewport(0, 0, shadowMap.size, shadowMap.size);
     glClearDepth(1.0);
     glClear(GL_DEPTH_BUFFER_BIT);
 }
@@ -96,3 +195,84 @@ void Lighting::endShadow()
 {
     gl::Framebuffer::bindDefault();
 }
+
+std::vector<LightSphere> Lighting::getLightSpheres(const glm::mat4& view) const
+{
+    std::vector<LightSphere> spheres;
+    spheres.reserve(localLights.size());
+    for (const auto& light : localLights)
+        spheres.push_back({ glm::vec3(view * glm::vec4(light.position, 1.0f)), light.radius });
+    return spheres;
+}
+
+void Lighting::uploadLocalLights(gl::StreamBuffer& streamBuffer, const glm::mat4& view)
+{
+    // The shaders work in view space
+    std::vector<GpuLight> lights;
+    lights.reserve(localLights.size());
+    for (const auto& light : localLights)
+        lights.push_back({ glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.radius),
+            glm::vec4(light.color, light.cosOuter), glm::vec4(glm::normalize(glm::mat3(view) * light.direction), light.cosInner) });
+    lightData = streamBuffer.upload(lights);
+}
+
+void Lighting::shadeLocalLights(gl::StreamBuffer& streamBuffer, const GBuffer& gbuffer, gl::Texture2D& target, const glm::mat4& projection,
+    const glm::mat4& view, int width, int height)
+{
+    if (localLights.empty() || clustered) return;
+    uploadLocalLights(streamBuffer, view);
+
+    tilesX = (width + LightTileSize - 1) / LightTileSize;
+    tilesY = (height + LightTileSize - 1) / LightTileSize;
+    tileBuffer.allocate(std::size_t(tilesX) * tilesY * LightTiles::TileStride * sizeof(std::uint32_t));
+
+    tiledLightingProgram->use();
+    gbuffer.setParams(*tiledLightingProgram, projection);
+    tiledLightingProgram->setUniform("NumLights", (int)localLights.size());
+    tiledLightingProgram->setUniform("SpecularColor", MaterialSpecularColor);
+    target.bindImageTo(0, gl::InternalFormat::RGBA8);
+    tiledLightingProgram->setUniform("OutputImage", 0);
+    lightData.bindTo(GL_SHADER_STORAGE_BUFFER, 0);
+    tileBuffer.bindTo(1);
+
+    glDispatchCompute(tilesX, tilesY, 1); gl::checkError();
+
+    // The next passes sample the image as a texture
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT); gl::checkError();
+}
+
+LightTiles Lighting::readLightTiles() const
+{
+    LightTiles tiles(tilesX, tilesY);
+    tileBuffer.download(tiles.data.data(), tiles.data.size() * sizeof(std::uint32_t));
+    return tiles;
+}
+
+void Lighting::buildLightClusters(gl::StreamBuffer& streamBuffer, const glm::mat4& projection, const glm::mat4& view)
+{
+    lastClusterTime = 0;
+    if (localLights.empty() || !clustered) return;
+    uploadLocalLights(streamBuffer, view);
+
+    // Only the assignment is timed, the uploads may have to wait for an older frame
+    auto then = std::chrono::high_resolution_clock::now();
+    clusterBuilder.setProjection(projection);
+    auto clusters = clusterBuilder.assignLights(getLightSpheres(view));
+    lastClusterTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - then).count();
+
+    clusterData = streamBuffer.upload(clusters.ranges);
+    clusterIndexData = streamBuffer.upload(clusters.indices);
+}
+
+void Lighting::setClusterParams(gl::Program& program) const
+{
+    auto enabled = clustered && !localLights.empty();
+    program.setUniform("UseClusteredLights", enabled ? 1 : 0);
+    if (!enabled) return;
+
+    program.setUniform("ClusterSliceScale", clusterBuilder.getSliceScale());
+    program.setUniform("ClusterSliceBias", clusterBuilder.getSliceBias());
+    lightData.bindTo(GL_SHADER_STORAGE_BUFFER, 0);
+    clusterData.bindTo(GL_SHADER_STORAGE_BUFFER, 2);
+    clusterIndexData.bindTo(GL_SHADER_STORAGE_BUFFER, 3);
+}
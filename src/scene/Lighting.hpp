@@ -3,33 +3,110 @@
 #include "resources/Program.hpp"
 #include "resources/Texture.hpp"
 #include "resources/Framebuffer.hpp"
+#include "resources/StorageBuffer.hpp"
+#include "resources/StreamBuffer.hpp"
+#include "LightBinning.hpp"
+#include "LightClusters.hpp"
 #include <memory>
+#include <vector>
 
 namespace scene
 {
-    class Lighting final
+    class GBuffer;
+
+    // A point light, or a spot light when its cone angles are set
+    struct LocalLight
     {
+        glm::vec3 position;
+        float radius;
+        glm::vec3 color;
+        glm::vec3 direction = glm::vec3(0, -1, 0);
+
+        // Cosines of the angles where the cone starts fading and where it ends, so a point light spans everything
+        float cosInner = -1, cosOuter = -2;
+    };
+
+    // Must match the constant in lighting.glsl
+    constexpr int NumShadowCascades = 4;
 
-        // Details for the shadow map
+    class Lighting final
+    {
+        // The view frustum is split in depth into cascades, each one with its own layer of the shadow map,
+        // fitted around it, so the texel density follows the distance to the camera instead of the scene size
         struct ShadowMap
         {
-            glm::mat4 viewProjection;
-            gl::Framebuffer framebuffer;
-            gl::Texture2D depthTexture;
-            GLsizei width, height;
+            std::vector<glm::mat4> viewProjections;
+            std::vector<float> splits; // The view space distance where each cascade ends
+            std::vector<float> texelSizes;
+            std::vector<gl::Framebuffer> framebuffers;
+            gl::Texture2DArray depthTexture;
+            GLsizei size;
+            float distance;
+
+            // The scene seen from the light, which bounds the depth range of every cascade
+            glm::mat4 lightView;
+            glm::vec3 sceneMin, sceneMax;
+            glm::vec3 boundsMin, boundsMax;
+
+            // The projection each layer was last drawn with, so it is only drawn again when it moves or gets invalidated
+            std::vector<glm::mat4> drawnViewProjections;
         } shadowMap;
 
         glm::vec3 lightDirection;
 
+        // The local lights are binned into screen tiles and shaded by a compute shader
+        // Their data is streamed every frame
+        std::vector<LocalLight> localLights;
+        gl::StreamBuffer::Allocation lightData;
+        gl::StorageBuffer tileBuffer;
+        std::shared_ptr<gl::Program> tiledLightingProgram;
+        int tilesX, tilesY;
+
+        // Or assigned to clusters of the view frustum on the CPU, and shaded while resolving
+        bool clustered;
+        LightClusterBuilder clusterBuilder;
+        gl::StreamBuffer::Allocation clusterData, clusterIndexData;
+        double lastClusterTime;
+
+        void uploadLocalLights(gl::StreamBuffer& streamBuffer, const glm::mat4& view);
+
     public:
-        Lighting(float xmin, float ymin, float zmin, float xmax, float ymax, float zmax, float resolution, 
+        // Each cascade gets a square layer of cascadeSize texels, and they cover the view up to shadowDistance
+        Lighting(float xmin, float ymin, float zmin, float xmax, float ymax, float zmax, GLsizei cascadeSize, float shadowDistance,
             glm::vec3 lightDirection);
 
-        glm::mat4 getShadowProjection() const;
+        // Fits the cascades to the view frustum, once per frame before drawing them
+        void fitShadowCascades(const glm::mat4& projection, const glm::mat4& view);
+
+        glm::mat4 getShadowProjection(int cascade) const;
+
+        // The shadow maps are kept between frames, so they have to be drawn again when the geometry or the light changes
+        void setLightDirection(glm::vec3 direction);
+        void invalidateShadows();
+        bool needsShadowUpdate(int cascade) const;
         void setLightParams(gl::Program& program, const glm::mat4& view) const;
         void setShadowMapTexture(gl::Program& program) const;
 
-        void beginShadow();
+        void beginShadow(int cascade);
         void endShadow();
+
+        void setLocalLights(std::vector<LocalLight> lights) { localLights = std::move(lights); }
+        std::size_t getNumLocalLights() const { return localLights.size(); }
+        std::vector<LightSphere> getLightSpheres(const glm::mat4& view) const;
+
+        // Adds the local lights to the resolved image
+        void shadeLocalLights(gl::StreamBuffer& streamBuffer, const GBuffer& gbuffer, gl::Texture2D& target, const glm::mat4& projection,
+            const glm::mat4& view, int width, int height);
+        LightTiles readLightTiles() const;
+
+        void setClustered(bool enabled) { clustered = enabled; }
+        bool isClustered() const { return clustered; }
+
+        // Assigns the local lights to the clusters, which the resolve pass then reads
+        void buildLightClusters(gl::StreamBuffer& streamBuffer, const glm::mat4& projection, const glm::mat4& view);
+        void setClusterParams(gl::Program& program) const;
+
+        // The CPU time of the last assignment, in milliseconds
+        double getLastClusterTime() const { return lastClusterTime; }
     };
 }
\ No newline at end of file
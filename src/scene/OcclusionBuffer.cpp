@@ -0,0 +1,262 @@
+#include "OcclusionBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define OCCLUSION_SIMD
+#endif
+
+using namespace scene;
+
+static float cross(const glm::vec2& o, const glm::vec2& a, const glm::vec2& b)
+{
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// Andrew's monotone chain, which gives the hull counterclockwise without repeating the first point
+static std::vector<glm::vec2> convexHull(std::vector<glm::vec2> points)
+{
+    std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+
+    std::vector<glm::vec2> hull(2 * points.size());
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+        hull[k++] = points[i];
+    }
+    for (std::size_t i = points.size() - 1, t = k + 1; i > 0; i--)
+    {
+        while (k >= t && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0) k--;
+        hull[k++] = points[i - 1];
+    }
+
+    hull.resize(k > 0 ? k - 1 : 0);
+    return hull;
+}
+
+OcclusionBuffer::OcclusionBuffer(unsigned numWorkers) : viewProjection(1.0f), depth(std::size_t(OcclusionWidth) * OcclusionHeight, 1.0f),
+    numWorkers(numWorkers != 0 ? numWorkers : std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+void OcclusionBuffer::clear(const glm::mat4& viewProjection)
+{
+    this->viewProjection = viewProjection;
+    polygons.clear();
+}
+
+bool OcclusionBuffer::project(const glm::vec3& point, glm::vec3& result) const
+{
+    // Anything in front of the near plane cannot be projected without clipping
+    auto clip = viewProjection * glm::vec4(point, 1.0f);
+    if (clip.w <= 0.0f || clip.z < -clip.w) return false;
+
+    auto ndc = glm::vec3(clip) / clip.w;
+    result = glm::vec3((ndc.x * 0.5f + 0.5f) * OcclusionWidth, (ndc.y * 0.5f + 0.5f) * OcclusionHeight, ndc.z * 0.5f + 0.5f);
+    return true;
+}
+
+void OcclusionBuffer::addPolygon(std::vector<glm::vec2> points, const glm::vec3& depthPlane)
+{
+    auto hull = convexHull(std::move(points));
+    if (hull.size() < 3 || hull.size() > Polygon::MaxEdges) return;
+
+    Polygon polygon;
+    polygon.numEdges = (int)hull.size();
+    polygon.depthPlane = depthPlane;
+
+    auto min = hull[0], max = hull[0];
+    for (std::size_t i = 0; i < hull.size(); i++)
+    {
+        const auto& v0 = hull[i];
+        const auto& v1 = hull[(i + 1) % hull.size()];
+
+        // Positive inside, and shifted so the center of a pixel only passes when the whole pixel is inside
+        auto a = v0.y - v1.y, b = v1.x - v0.x;
+        auto c = -(a * v0.x + b * v0.y) - 0.5f * (std::abs(a) + std::abs(b));
+        polygon.edges[i] = glm::vec3(a, b, c);
+
+        min = glm::min(min, v0);
+        max = glm::max(max, v0);
+    }
+
+    polygon.min = glm::clamp(glm::ivec2(glm::floor(min)), glm::ivec2(0), glm::ivec2(OcclusionWidth, OcclusionHeight));
+    polygon.max = glm::clamp(glm::ivec2(glm::ceil(max)), glm::ivec2(0), glm::ivec2(OcclusionWidth, OcclusionHeight));
+    if (polygon.min.x >= polygon.max.x || polygon.min.y >= polygon.max.y) return;
+
+    polygons.push_back(polygon);
+}
+
+void OcclusionBuffer::addBox(const glm::vec3& min, const glm::vec3& max)
+{
+    std::vector<glm::vec2> points;
+    auto farthest = 0.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner;
+        if (!project(glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z), corner)) return;
+        points.emplace_back(corner);
+        farthest = std::max(farthest, corner.z);
+    }
+
+    addPolygon(std::move(points), glm::vec3(0.0f, 0.0f, farthest));
+}
+
+void OcclusionBuffer::addQuad(const std::array<glm::vec3, 4>& corners)
+{
+    std::array<glm::vec3, 4> projected;
+    for (int i = 0; i < 4; i++)
+        if (!project(corners[i], projected[i])) return;
+
+    // The depth is linear in screen space, so three corners give its plane
+    const auto& p0 = projected[0];
+    const auto& p1 = projected[1];
+    const auto& p2 = projected[2];
+    auto det = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+
+    // Seen edge on, it does not cover anything
+    if (std::abs(det) < 1e-6f) return;
+
+    auto dx = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / det;
+    auto dy = ((p1.x - p0.x) * (p2.z - p0.z) - (p2.x - p0.x) * (p1.z - p0.z)) / det;
+
+    // Evaluated at the centers of the pixels, so push it back to the farthest point of each pixel
+    auto d = p0.z - dx * p0.x - dy * p0.y + 0.5f * (std::abs(dx) + std::abs(dy));
+
+    std::vector<glm::vec2> points;
+    for (const auto& corner : projected) points.emplace_back(corner);
+    addPolygon(std::move(points), glm::vec3(dx, dy, d));
+}
+
+void OcclusionBuffer::rasterizeTile(int tile, bool simd)
+{
+    auto tileMin = glm::ivec2(tile % TilesX * TileWidth, tile / TilesX * TileHeight);
+    auto tileMax = tileMin + glm::ivec2(TileWidth, TileHeight);
+
+    for (auto y = tileMin.y; y < tileMax.y; y++)
+        std::fill_n(depth.begin() + std::size_t(y) * OcclusionWidth + tileMin.x, TileWidth, 1.0f);
+
+    for (const auto& polygon : polygons)
+    {
+        auto min = glm::max(polygon.min, tileMin);
+        auto max = glm::min(polygon.max, tileMax);
+        if (min.x >= max.x || min.y >= max.y) continue;
+
+        // Whole vectors at a time, the pixels outside the polygon fail the edge tests anyway
+        min.x &= ~3;
+        max.x = std::min((max.x + 3) & ~3, tileMax.x);
+
+        for (auto y = min.y; y < max.y; y++)
+        {
+            // The terms which are the same for the whole row, computed the same way for every path
+            auto yc = float(y) + 0.5f;
+            std::array<float, Polygon::MaxEdges> rowEdges;
+            for (int i = 0; i < polygon.numEdges; i++)
+                rowEdges[i] = polygon.edges[i].y * yc + polygon.edges[i].z;
+            auto rowDepth = polygon.depthPlane.y * yc + polygon.depthPlane.z;
+
+            auto row = depth.data() + std::size_t(y) * OcclusionWidth;
+            auto x = min.x;
+#ifdef OCCLUSION_SIMD
+            if (simd)
+            {
+#ifdef __AVX__
+                for (; x + 8 <= max.x; x += 8)
+                {
+                    auto xc = _mm256_add_ps(_mm256_set1_ps(float(x)), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+                    auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                    for (int i = 0; i < polygon.numEdges; i++)
+                    {
+                        auto edge = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(polygon.edges[i].x), xc), _mm256_set1_ps(rowEdges[i]));
+                        inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, _mm256_setzero_ps(), _CMP_GE_OQ));
+                    }
+
+                    auto z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(polygon.depthPlane.x), xc), _mm256_set1_ps(rowDepth));
+                    auto current = _mm256_loadu_ps(row + x);
+                    _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+                }
+#endif
+                for (; x + 4 <= max.x; x += 4)
+                {
+                    auto xc = _mm_add_ps(_mm_set1_ps(float(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+                    auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int i = 0; i < polygon.numEdges; i++)
+                    {
+                        auto edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(polygon.edges[i].x), xc), _mm_set1_ps(rowEdges[i]));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, _mm_setzero_ps()));
+                    }
+
+                    // Plain SSE has no blend, so select with the mask
+                    auto z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(polygon.depthPlane.x), xc), _mm_set1_ps(rowDepth));
+                    auto current = _mm_loadu_ps(row + x);
+                    auto result = _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(current, z)), _mm_andnot_ps(inside, current));
+                    _mm_storeu_ps(row + x, result);
+                }
+            }
+#endif
+            for (; x < max.x; x++)
+            {
+                auto xc = float(x) + 0.5f;
+                auto inside = true;
+                for (int i = 0; i < polygon.numEdges; i++)
+                    inside = inside && polygon.edges[i].x * xc + rowEdges[i] >= 0.0f;
+
+                // Same operand order as _mm_min_ps, which returns the second one on ties
+                auto z = polygon.depthPlane.x * xc + rowDepth;
+                if (inside) row[x] = row[x] < z ? row[x] : z;
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::rasterize(bool simd, unsigned workers)
+{
+    // The tiles are independent, so each worker can take its own without any locking
+    constexpr int NumTiles = TilesX * TilesY;
+    auto work = [&](unsigned worker, unsigned numWorkers)
+    {
+        for (int tile = worker; tile < NumTiles; tile += numWorkers)
+            rasterizeTile(tile, simd);
+    };
+
+    workers = std::clamp(workers, 1u, (unsigned)NumTiles);
+    if (workers == 1) work(0, 1);
+    else
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(workers - 1);
+        for (unsigned worker = 1; worker < workers; worker++)
+            threads.emplace_back(work, worker, workers);
+        work(0, workers);
+    }
+}
+
+bool OcclusionBuffer::isVisible(const glm::vec3& min, const glm::vec3& max) const
+{
+    auto screenMin = glm::vec2(INFINITY), screenMax = glm::vec2(-INFINITY);
+    auto nearest = 1.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner;
+        if (!project(glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z), corner)) return true;
+        screenMin = glm::min(screenMin, glm::vec2(corner));
+        screenMax = glm::max(screenMax, glm::vec2(corner));
+        nearest = std::min(nearest, corner.z);
+    }
+
+    // Every pixel the box touches has to be behind an occluder
+    auto pixelMin = glm::clamp(glm::ivec2(glm::floor(screenMin)), glm::ivec2(0), glm::ivec2(OcclusionWidth, OcclusionHeight));
+    auto pixelMax = glm::clamp(glm::ivec2(glm::ceil(screenMax)), glm::ivec2(0), glm::ivec2(OcclusionWidth, OcclusionHeight));
+    if (pixelMin.x >= pixelMax.x || pixelMin.y >= pixelMax.y) return true;
+
+    for (auto y = pixelMin.y; y < pixelMax.y; y++)
+    {
+        auto row = depth.data() + std::size_t(y) * OcclusionWidth;
+        for (auto x = pixelMin.x; x < pixelMax.x; x++)
+            if (row[x] >= nearest) return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+namespace scene
+{
+    constexpr int OcclusionWidth = 256;
+    constexpr int OcclusionHeight = 128;
+
+    // A small depth buffer rasterized on the CPU from a few large occluders, used to skip the objects hidden behind them.
+    // It is conservative: a pixel only takes an occluder's depth if the occluder covers all of it, and the depth stored is
+    // never nearer than the occluder anywhere in that pixel, so no visible object is ever reported as hidden
+    class OcclusionBuffer final
+    {
+        // Both must be multiples of the SIMD width
+        static constexpr int TileWidth = 64;
+        static constexpr int TileHeight = 32;
+        static constexpr int TilesX = OcclusionWidth / TileWidth;
+        static constexpr int TilesY = OcclusionHeight / TileHeight;
+
+        // A convex polygon in pixel coordinates, with its depth plane. Each edge is a x + b y + c,
+        // and a pixel is covered when every edge is at least the bias at its center
+        struct Polygon
+        {
+            static constexpr int MaxEdges = 8;
+
+            int numEdges;
+            std::array<glm::vec3, MaxEdges> edges;
+            glm::vec3 depthPlane; // depth = x * dx + y * dy + d, already pushed to the back of each pixel
+            glm::ivec2 min, max;  // The pixel bounds, max excluded
+        };
+
+        glm::mat4 viewProjection;
+        std::vector<float> depth;
+        std::vector<Polygon> polygons;
+        unsigned numWorkers;
+
+        bool project(const glm::vec3& point, glm::vec3& result) const;
+        void addPolygon(std::vector<glm::vec2> points, const glm::vec3& depthPlane);
+        void rasterizeTile(int tile, bool simd);
+
+    public:
+        // Zero workers uses one per hardware thread
+        OcclusionBuffer(unsigned numWorkers = 0);
+
+        // Starts a new frame, without any occluders
+        void clear(const glm::mat4& viewProjection);
+
+        // Boxes are drawn as their outline on the screen, at the depth of their farthest corner
+        void addBox(const glm::vec3& min, const glm::vec3& max);
+
+        // The corners must go around the quad, which must be flat
+        void addQuad(const std::array<glm::vec3, 4>& corners);
+
+        // Occluders crossing the near plane are left out, which is also conservative
+        void rasterize(bool simd = true) { rasterize(simd, numWorkers); }
+        void rasterize(bool simd, unsigned workers);
+
+        // False only if the box is entirely behind the occluders
+        bool isVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+        std::size_t getNumOccluders() const { return polygons.size(); }
+
+        // Row by row from the bottom, in normalized depth from 0 to 1
+        const std::vector<float>& getDepth() const { return depth; }
+    };
+}
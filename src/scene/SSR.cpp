@@ -3,56 +3,272 @@
 #include "Scene.hpp"
 #include "resources/Cache.hpp"
 #include <optional>
+#include <algorithm>
+#include <string>
 
 using namespace scene;
 
-SSR::SSR(const glfw::Size& size) : width(size.width), height(size.height)
+SSR::SSR(const glfw::Size& size) : width(size.width), height(size.height), traceScale(1),
+    currentReflection(0), frameIndex(0), traceOffset(0), lastView(1.0f), temporal(false), historyValid(false), reflectionsResolved(false)
 {
-    ssrTexcoord.assign(0, gl::InternalFormat::RG16i, (GLsizei)width, (GLsizei)height);
-    ssrTexcoord.setName("SSR Texcoord Texture");
+    ssrProgram = cache::loadProgram({ "resources/shaders/fullScreenQuad.vert", "resources/shaders/ssr.frag" });
+    hizReduceProgram = cache::loadProgram({ "resources/shaders/fullScreenQuad.vert", "resources/shaders/hizReduce.frag" });
+    ssrHiZProgram = cache::loadProgram({ "resources/shaders/fullScreenQuad.vert", "resources/shaders/ssrHiZ.frag" });
+    ssrTemporalProgram = cache::loadProgram({ "resources/shaders/fullScreenQuad.vert", "resources/shaders/ssrTemporal.frag" });
+    ssrCompositeProgram = cache::loadProgram({ "resources/shaders/ssrComposite.comp" });
+}
+
+void SSR::allocateReflections()
+{
+    // The storage is immutable, so the textures are replaced when their size changes.
+    // The alpha keeps the view space depth, to detect disocclusions
+    if (temporal)
+        for (std::size_t i = 0; i < reflections.size(); i++)
+        {
+            reflections[i] = gl::Texture2D();
+            reflections[i].storage(1, gl::InternalFormat::RGBA16f, traceWidth(), traceHeight());
+            reflections[i].setMagFilter(gl::MagFilter::Nearest);
+            reflections[i].setMinFilter(gl::MinFilter::Nearest);
+            reflections[i].setName("SSR Reflection Texture " + std::to_string(i));
+
+            reflectionFramebuffers[i] = gl::Framebuffer();
+            reflectionFramebuffers[i].attach(gl::ColorAttachment(0), reflections[i]);
+            reflectionFramebuffers[i].setName("SSR Reflection Framebuffer " + std::to_string(i));
+        }
+    historyValid = false;
+}
+
+void SSR::setTraceScale(int scale)
+{
+    if (scale == traceScale) return;
+    traceScale = scale;
+    allocateReflections();
+}
+
+void SSR::setTemporal(bool enabled)
+{
+    if (enabled == temporal) return;
+    temporal = enabled;
+    allocateReflections();
+}
+
+GLint SSR::pyramidLevels() const
+{
+    // The whole pyramid, down to 1x1
+    GLint levels = 1;
+    for (auto size = std::max(width, height); size > 1; size /= 2) levels++;
+    return levels;
+}
 
-    ssrVisibility.assign(0, gl::InternalFormat::R32f, (GLsizei)width, (GLsizei)height);
-    ssrVisibility.setName("SSR Visibility Texture");
+SSRTargets SSR::addPasses(FrameGraph& graph, const GBuffer& gbuffer, const GBufferTargets& gbufferTargets, FrameGraph::Resource resolve,
+    const glm::mat4& projection, const glm::mat4& view, SSRMode mode, const std::string& zone)
+{
+    // Only the Hi-Z tracer reads the pyramid, so it is culled with the linear one
+    auto pyramidPass = graph.addPass("Hi-Z Pyramid", zone);
+    pyramidPass.read(gbufferTargets.depth);
+    auto pyramid = pyramidPass.create("Hi-Z Pyramid", { gl::InternalFormat::R32f, (GLsizei)width, (GLsizei)height, pyramidLevels() });
+    pyramidPass.setExecute([=, this](FrameGraph& graph) { buildDepthPyramid(graph, gbufferTargets.depth, pyramid); });
+
+    // The hit coordinates are still full resolution, only the number of traced pixels changes.
+    // With temporal reuse, only the pixels traced in one frame are kept
+    auto tracePass = graph.addPass("SSR Trace", zone);
+    gbuffer.readTargets(tracePass, gbufferTargets);
+    tracePass.read(resolve);
+    if (mode == SSRMode::HiZ) tracePass.read(pyramid);
+    SSRTargets targets
+    {
+        tracePass.create("SSR Texcoord", { gl::InternalFormat::RG16i, hitWidth(), hitHeight() }),
+        tracePass.create("SSR Visibility", { gl::InternalFormat::R32f, hitWidth(), hitHeight() }),
+        std::nullopt
+    };
+    std::optional<FrameGraph::Resource> color;
+    if (temporal) color = tracePass.create("SSR Color", { gl::InternalFormat::RGBA16f, hitWidth(), hitHeight() });
+    tracePass.setExecute([=, this, &gbuffer](FrameGraph& graph)
+    {
+        drawSSR(graph, gbuffer, targets, color, resolve, pyramid, projection, mode);
+    });
 
-    for (auto texture : { &ssrTexcoord, &ssrVisibility })
+    if (temporal)
     {
-        texture->setMagFilter(gl::MagFilter::Nearest);
-        texture->setMinFilter(gl::MinFilter::Nearest);
+        auto temporalPass = graph.addPass("SSR Temporal Resolve", zone);
+        gbuffer.readTargets(temporalPass, gbufferTargets);
+        temporalPass.read(*color);
+        targets.reflections = temporalPass.write(graph.import("SSR Reflections"));
+        temporalPass.setExecute([=, this, &gbuffer](FrameGraph& graph)
+        {
+            resolveReflections(gbuffer, graph.getTexture(*color), projection, view);
+        });
     }
 
-    ssrFramebuffer.attach(gl::ColorAttachment(0), ssrTexcoord);
-    ssrFramebuffer.attach(gl::ColorAttachment(1), ssrVisibility);
-    ssrFramebuffer.setDrawBuffers(gl::ColorAttachment(0), gl::ColorAttachment(1));
-    ssrFramebuffer.setName("SSR Framebuffer");
+    return targets;
+}
 
-    ssrProgram = cache::loadProgram({ "resources/shaders/fullScreenQuad.vert", "resources/shaders/ssr.frag" });
+void SSR::buildDepthPyramid(FrameGraph& graph, FrameGraph::Resource depth, FrameGraph::Resource pyramid)
+{
+    hizReduceProgram->use();
+    hizReduceProgram->setUniform("SourceTexture", 0);
+
+    auto& hizTexture = graph.getTexture(pyramid);
+    auto levels = pyramidLevels();
+    auto levelWidth = (GLsizei)width, levelHeight = (GLsizei)height;
+    for (GLint level = 0; level < levels; level++)
+    {
+        graph.getFramebuffer({ pyramid }, std::nullopt, level).bind();
+        gl::StateCache::viewport(0, 0, levelWidth, levelHeight);
+
+        // Level 0 copies the depth buffer, then each level reduces the previous one,
+        // which is the only one left visible so there is no feedback loop
+        if (level == 0) graph.getTexture(depth).bindTo(0);
+        else
+        {
+            hizTexture.setLevelRange(level - 1, level - 1);
+            hizTexture.bindTo(0);
+        }
+
+        hizReduceProgram->setUniform("Downsample", level != 0 ? 1 : 0);
+        Scene::drawFullScreenQuad();
+
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+
+    hizTexture.setLevelRange(0, levels - 1);
 }
 
-void SSR::drawSSR(const GBuffer& gbuffer, const glm::mat4& projection)
+void SSR::drawSSR(FrameGraph& graph, const GBuffer& gbuffer, const SSRTargets& targets, std::optional<FrameGraph::Resource> color,
+    FrameGraph::Resource resolve, FrameGraph::Resource pyramid, const glm::mat4& projection, SSRMode mode)
 {
     // Draw SSR
-    clearSSR();
+    clearSSR(color ? graph.getFramebuffer({ targets.texcoord, targets.visibility, *color })
+        : graph.getFramebuffer({ targets.texcoord, targets.visibility }));
+
+    // Rotate the traced pixel of each block, so all of them are refreshed every four frames
+    constexpr glm::ivec2 TraceOffsets[] = { { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };
+    traceOffset = temporal ? TraceOffsets[frameIndex++ % 4] : glm::ivec2(0);
 
-    ssrProgram->use();
-    gbuffer.setParams(*ssrProgram, projection);
-    ssrProgram->setUniform("Projection", projection);
+    auto& program = mode == SSRMode::HiZ ? *ssrHiZProgram : *ssrProgram;
+    program.use();
+    gbuffer.setParams(program, projection);
+    program.setUniform("Projection", projection);
+    program.setUniform("TraceScale", traceScale);
+    program.setUniform("TraceInterleave", traceInterleave());
+    program.setUniform("TraceOffset", traceOffset);
+    graph.getTexture(resolve).bindTo(0);
+    program.setUniform("ResolveTexture", 0);
+    if (mode == SSRMode::HiZ)
+    {
+        graph.getTexture(pyramid).bindTo(6);
+        program.setUniform("HiZTexture", 6);
+    }
     Scene::drawFullScreenQuad();
 }
 
-void SSR::clearSSR()
+void SSR::resolveReflections(const GBuffer& gbuffer, const gl::Texture2D& color, const glm::mat4& projection, const glm::mat4& view)
 {
-    ssrFramebuffer.bind();
-    glViewport(0, 0, (GLsizei)width, (GLsizei)height); gl::checkError();
+    const auto& history = reflections[currentReflection];
+    currentReflection = 1 - currentReflection;
+    reflectionFramebuffers[currentReflection].bind();
+    gl::StateCache::viewport(0, 0, traceWidth(), traceHeight());
+
+    ssrTemporalProgram->use();
+    gbuffer.setParams(*ssrTemporalProgram, projection);
+    ssrTemporalProgram->setUniform("Projection", projection);
+    ssrTemporalProgram->setUniform("Reprojection", lastView * glm::inverse(view));
+    ssrTemporalProgram->setUniform("TraceScale", traceScale);
+    ssrTemporalProgram->setUniform("TraceInterleave", traceInterleave());
+    ssrTemporalProgram->setUniform("TraceOffset", traceOffset);
+    ssrTemporalProgram->setUniform("HistoryValid", historyValid ? 1 : 0);
+
+    color.bindTo(7);
+    ssrTemporalProgram->setUniform("SSRColorTexture", 7);
+    history.bindTo(9);
+    ssrTemporalProgram->setUniform("HistoryTexture", 9);
+    Scene::drawFullScreenQuad();
+
+    lastView = view;
+    historyValid = true;
+    reflectionsResolved = true;
+}
+
+void SSR::clearSSR(const gl::Framebuffer& framebuffer)
+{
+    framebuffer.bind();
+    gl::StateCache::viewport(0, 0, hitWidth(), hitHeight());
     const GLint values[] = { -1, -1 };
     const float fval = 0.0f;
     glClearBufferiv(GL_COLOR, 0, values);
     glClearBufferfv(GL_COLOR, 1, &fval);
+    if (temporal)
+    {
+        const float color[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 2, color);
+    }
+
+    // The history is only good if the last frame resolved its reflections
+    historyValid = historyValid && reflectionsResolved;
+    reflectionsResolved = false;
 }
 
-void SSR::setTextureParam(gl::Program& program) const
+void SSR::drawComposite(const GBuffer& gbuffer, const gl::Texture2D& resolveTexture, const gl::Texture2D& output,
+    const glm::mat4& projection, bool traceReflections)
 {
-    ssrTexcoord.bindTo(7);
+    ssrCompositeProgram->use();
+    gbuffer.setParams(*ssrCompositeProgram, projection);
+    ssrCompositeProgram->setUniform("Projection", projection);
+    ssrCompositeProgram->setUniform("TraceScale", traceScale);
+    ssrCompositeProgram->setUniform("TraceReflections", traceReflections ? 1 : 0);
+    resolveTexture.bindTo(0);
+    ssrCompositeProgram->setUniform("ResolveTexture", 0);
+    output.bindImageTo(0, gl::InternalFormat::RGBA8, GL_WRITE_ONLY);
+    ssrCompositeProgram->setUniform("OutputImage", 0);
+
+    // Each group covers a tile of traced pixels
+    auto groupsX = (traceWidth() + SSRCompositeTileSize - 1) / SSRCompositeTileSize;
+    auto groupsY = (traceHeight() + SSRCompositeTileSize - 1) / SSRCompositeTileSize;
+    glDispatchCompute(groupsX, groupsY, 1); gl::checkError();
+
+    // The output is copied to the framebuffer next
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT); gl::checkError();
+
+    // Nothing was written to the history
+    reflectionsResolved = false;
+}
+
+std::size_t SSR::getIntermediateBytes() const
+{
+    // The hit coordinates and the visibility, then with temporal reuse the reflected color and the resolved reflections
+    auto bytes = std::size_t(hitWidth()) * hitHeight() * (4 + 4);
+    if (temporal) bytes += std::size_t(hitWidth()) * hitHeight() * 8 + std::size_t(traceWidth()) * traceHeight() * 8;
+    return bytes;
+}
+
+void SSR::readTargets(FrameGraph::Builder& builder, const SSRTargets& targets) const
+{
+    // The resolved reflections replace the traced ones
+    if (targets.reflections) builder.read(*targets.reflections);
+    else
+    {
+        builder.read(targets.texcoord);
+        builder.read(targets.visibility);
+    }
+}
+
+void SSR::setTextureParam(gl::Program& program, const FrameGraph& graph, const SSRTargets* targets) const
+{
+    // The samplers keep their own units even when they are not read
     program.setUniform("SSRTexcoordTexture", 7);
-    ssrVisibility.bindTo(8);
     program.setUniform("SSRVisibilityTexture", 8);
+    program.setUniform("ReflectionTexture", 9);
+    program.setUniform("TraceScale", traceScale);
+    program.setUniform("DrawReflections", targets ? 1 : 0);
+    if (!targets) return;
+
+    // The reflections were already resolved, so the final step only has to upsample them
+    program.setUniform("UseReflectionTexture", reflectionsResolved ? 1 : 0);
+    if (reflectionsResolved) reflections[currentReflection].bindTo(9);
+    else
+    {
+        graph.getTexture(targets->texcoord).bindTo(7);
+        graph.getTexture(targets->visibility).bindTo(8);
+    }
 }
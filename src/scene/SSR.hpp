@@ -5,22 +5,93 @@
 #include "wrappers/glfw.hpp"
 #include "resources/Program.hpp"
 #include "GBuffer.hpp"
+#include "FrameGraph.hpp"
+#include <array>
+#include <optional>
 
 namespace scene
 {
+    // Linear marches the ray in fixed steps, HiZ skips empty space with a min-depth pyramid
+    enum class SSRMode { Linear, HiZ };
+
+    // Must match the constant in ssrComposite.comp
+    constexpr int SSRCompositeTileSize = 16;
+
+    // The textures of the reflections in the frame graph
+    struct SSRTargets
+    {
+        FrameGraph::Resource texcoord, visibility;
+        std::optional<FrameGraph::Resource> reflections;  // With temporal reuse, the resolved reflections
+    };
+
     class SSR final
     {
-        gl::Texture2D ssrTexcoord;
-        gl::Texture2D ssrVisibility;
-        gl::Framebuffer ssrFramebuffer;
+        // The hit coordinates, the visibility and the min-depth pyramid are transient textures of the frame graph
         std::shared_ptr<gl::Program> ssrProgram;
         std::size_t width, height;
+        int traceScale;
+
+        std::shared_ptr<gl::Program> hizReduceProgram;
+        std::shared_ptr<gl::Program> ssrHiZProgram;
+
+        // With temporal reuse, the trace also writes the reflected color, which is then merged with the
+        // reflections of the last frame. Those are at the traced resolution and swapped every frame
+        std::array<gl::Texture2D, 2> reflections;
+        std::array<gl::Framebuffer, 2> reflectionFramebuffers;
+        std::shared_ptr<gl::Program> ssrTemporalProgram;
+
+        // Traces the reflections and adds them to the lighting in one compute pass, straight into the output
+        std::shared_ptr<gl::Program> ssrCompositeProgram;
+        std::size_t currentReflection;
+        std::uint32_t frameIndex;
+        glm::ivec2 traceOffset;
+        glm::mat4 lastView;
+        bool temporal, historyValid, reflectionsResolved;
+
+        void buildDepthPyramid(FrameGraph& graph, FrameGraph::Resource depth, FrameGraph::Resource pyramid);
+        void allocateReflections();
+        void clearSSR(const gl::Framebuffer& framebuffer);
+        void drawSSR(FrameGraph& graph, const GBuffer& gbuffer, const SSRTargets& targets, std::optional<FrameGraph::Resource> color,
+            FrameGraph::Resource resolve, FrameGraph::Resource pyramid, const glm::mat4& projection, SSRMode mode);
+        void resolveReflections(const GBuffer& gbuffer, const gl::Texture2D& color, const glm::mat4& projection, const glm::mat4& view);
+        GLint pyramidLevels() const;
+        GLsizei traceWidth() const { return GLsizei((width + traceScale - 1) / traceScale); }
+        GLsizei traceHeight() const { return GLsizei((height + traceScale - 1) / traceScale); }
+        GLsizei traceInterleave() const { return temporal ? 2 : 1; }
+        GLsizei hitWidth() const { return (traceWidth() + traceInterleave() - 1) / traceInterleave(); }
+        GLsizei hitHeight() const { return (traceHeight() + traceInterleave() - 1) / traceInterleave(); }
 
     public:
         SSR(const glfw::Size& size);
 
-        void drawSSR(const GBuffer& gbuffer, const glm::mat4& projection);
-        void clearSSR();
-        void setTextureParam(gl::Program& program) const;
+        // Adds the passes which trace the reflections, building the min-depth pyramid before with the Hi-Z tracer and
+        // merging them with the last frames after with temporal reuse. The graph culls them unless the targets are read
+        SSRTargets addPasses(FrameGraph& graph, const GBuffer& gbuffer, const GBufferTargets& gbufferTargets, FrameGraph::Resource resolve,
+            const glm::mat4& projection, const glm::mat4& view, SSRMode mode, const std::string& zone);
+        void readTargets(FrameGraph::Builder& builder, const SSRTargets& targets) const;
+        // Without the targets, the final step leaves the reflections out
+        void setTextureParam(gl::Program& program, const FrameGraph& graph, const SSRTargets* targets) const;
+
+        // For the frames without reflections, after which the history is stale
+        void skipFrame() { historyValid = reflectionsResolved = false; }
+
+        // Only the linear tracer without temporal reuse can be fused with the final step
+        bool canComposite(SSRMode mode) const { return mode == SSRMode::Linear && !temporal; }
+
+        // Writes the final color to the output image, with the reflections if they are enabled, in a single pass
+        // which keeps the traced reflections of each tile in shared memory instead of the intermediate textures
+        void drawComposite(const GBuffer& gbuffer, const gl::Texture2D& resolveTexture, const gl::Texture2D& output,
+            const glm::mat4& projection, bool traceReflections);
+
+        // The bytes which the separate passes write to the intermediate textures and read back in the final step
+        std::size_t getIntermediateBytes() const;
+
+        // Rays are only traced for one pixel out of scale in each direction
+        void setTraceScale(int scale);
+        int getTraceScale() const { return traceScale; }
+
+        // Traces a rotating quarter of the pixels each frame and reprojects the rest from the last frames
+        void setTemporal(bool enabled);
+        bool isTemporal() const { return temporal; }
     };
 }
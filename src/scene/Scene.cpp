@@ -6,6 +6,10 @@
 #include <array>
 #include <thread>
 #include <optional>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
 #include "meshUtils.hpp"
 #include "colors.hpp"
 #include "util/grid.hpp"
@@ -22,10 +26,16 @@ constexpr float Bounds = 1.0f;
 constexpr float BottomY = -3.0f;
 constexpr std::size_t BoxGridWidth = 8;
 constexpr std::size_t BoxGridHeight = 6;
+constexpr std::size_t BoxChunkSize = 4;
 constexpr std::size_t MaxStackedBoxes = 4;
 constexpr float AverageNumSeeds = 3.7f;
 constexpr float BoxGenProb = 0.16f;
 constexpr float MeanShininess = 6.5f;
+constexpr GLsizei ShadowCascadeSize = 1024;
+constexpr float ShadowDistance = 24.0f;
+constexpr std::size_t DefaultLocalLights = 256;
+constexpr float LocalLightIntensity = 0.3f;
+constexpr GLsizeiptr StreamBufferSize = 16 << 20;
 
 constexpr std::array BoxColors
 { 
@@ -48,23 +58,64 @@ constexpr auto WallColor = withSpecular(colors::Red, 0.5);
 
 static std::optional<gl::Mesh> fullScreenQuad;
 
-Scene::Scene(glfw::Window& window) : window(window), camera(window, 1000.0f), gbuffer(window.getFramebufferSize()), ssr(window.getFramebufferSize()),
-    lighting(-Bounds, BottomY, -Bounds, Bounds + BoxGridWidth, (float)MaxStackedBoxes + 1, Bounds + BoxGridHeight, 1.0f/256.0f, LightDirection),
-    enableSSR(true), lastPressedSSR(false), lastPressedRegen(false), showCounters(false), lastPressedCounters(false)
+static AABB boundsOf(const gl::MeshBuilder& mesh)
 {
+    AABB bounds{ glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+    for (const auto& position : mesh.positions) bounds = bounds.merge({ position, position });
+    return bounds;
+}
+
+Scene::Scene(glfw::Window& window) : Scene(&window, window.getFramebufferSize(), nullptr, std::random_device{}()) {}
+
+Scene::Scene(glfw::Size size, const gl::Framebuffer& outputFramebuffer, std::uint32_t seed)
+    : Scene(nullptr, size, &outputFramebuffer, seed) {}
+
+Scene::Scene(glfw::Window* window, glfw::Size size, const gl::Framebuffer* outputFramebuffer, std::uint32_t seed)
+    : window(window), size(size), outputFramebuffer(outputFramebuffer),
+    camera(window ? Camera(*window, 1000.0f) : Camera(size, 1000.0f)),
+    lighting(-Bounds, BottomY, -Bounds, Bounds + BoxGridWidth, (float)MaxStackedBoxes + 1, Bounds + BoxGridHeight, ShadowCascadeSize, ShadowDistance, LightDirection),
+    gbuffer(size), streamBuffer(StreamBufferSize),
+    multiDraw(true), lastPressedMultiDraw(false),
+    occlusionCulling(true), lastPressedOcclusion(false), lastOcclusionTime(0),
+    fusedComposite(false), lastPressedFused(false),
+    ssr(size),
+    enableSSR(true), lastPressedSSR(false),
+    ssrMode(SSRMode::Linear), lastPressedSSRMode(false),
+    lastPressedSSRScale(false), lastPressedSSRTemporal(false),
+    showCounters(false), lastPressedCounters(false),
+    lastPressedRegen(false),
+    instancedBoxes(true), lastPressedInstancing(false),
+    streamInstances(false), lastPressedStreamInstances(false),
+    lastPressedLights(false), lastPressedClustered(false), lastPressedGBufferLayout(false),
+    engine(seed),
+    lastCameraCulling(), lastShadowCulling(), lastShadowCascadesDrawn(0), lastCompositeStats(), lastArenaStats()
+{
+    // Global state required by the scene
+    gl::StateCache::enable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL); gl::checkError();
+    gl::StateCache::enable(GL_CULL_FACE);
+    glCullFace(GL_BACK); gl::checkError();
+    glFrontFace(GL_CCW); gl::checkError();
+
+    streamBuffer.setName("Stream Buffer");
     camera.position = InitialPos;
     
     constexpr auto viewDir = ViewPos - InitialPos;
     camera.angles.y = std::atan2(viewDir.y, -viewDir.z);
 
-    // Generate the floor mesh
-    floorMesh = meshUtils::addParameters(meshUtils::planeUp(0.0f, -Bounds, -Bounds, Bounds + BoxGridWidth, Bounds + BoxGridHeight), FloorColor, 40.0f)
-        + meshUtils::addParameters(meshUtils::planeFront(Bounds + BoxGridHeight, -Bounds, BottomY, Bounds + BoxGridWidth, 0.0f), WallColor, 40.0f)
-        + meshUtils::addParameters(meshUtils::planeBack(-Bounds, -Bounds, BottomY, Bounds + BoxGridWidth, 0.0f), WallColor, 40.0f)
-        + meshUtils::addParameters(meshUtils::planeRight(Bounds + BoxGridWidth, BottomY, -Bounds, 0.0f, Bounds + BoxGridHeight), WallColor, 40.0f)
-        + meshUtils::addParameters(meshUtils::planeLeft(-Bounds, BottomY, -Bounds, 0.0f, Bounds + BoxGridHeight), WallColor, 40.0f);
+    // Generate the floor and the walls, each one as its own object
+    staticMeshes = {
+        meshUtils::addParameters(meshUtils::planeUp(0.0f, -Bounds, -Bounds, Bounds + BoxGridWidth, Bounds + BoxGridHeight), FloorColor, 40.0f),
+        meshUtils::addParameters(meshUtils::planeFront(Bounds + BoxGridHeight, -Bounds, BottomY, Bounds + BoxGridWidth, 0.0f), WallColor, 40.0f),
+        meshUtils::addParameters(meshUtils::planeBack(-Bounds, -Bounds, BottomY, Bounds + BoxGridWidth, 0.0f), WallColor, 40.0f),
+        meshUtils::addParameters(meshUtils::planeRight(Bounds + BoxGridWidth, BottomY, -Bounds, 0.0f, Bounds + BoxGridHeight), WallColor, 40.0f),
+        meshUtils::addParameters(meshUtils::planeLeft(-Bounds, BottomY, -Bounds, 0.0f, Bounds + BoxGridHeight), WallColor, 40.0f) };
+    geometryArena.setName("Geometry Arena");
+    uploadStaticObjects();
 
     // Generate the boxes
+    unitBoxMesh = meshUtils::box(glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+    unitBoxMesh.setName("Unit Box Mesh");
     generateBoxMesh();
 
     // Load the program
@@ -77,21 +128,11 @@ Scene::Scene(glfw::Window& window) : window(window), camera(window, 1000.0f), gb
     gl::MeshBuilder meshBuilder;
     meshBuilder.positions = { glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(-1, 1, 0), glm::vec3(1, 1, 0) };
     fullScreenQuad = gl::Mesh(meshBuilder, gl::PrimitiveType::TriangleStrip);
-
-    // Build the resolution framebuffer
-    const auto& size = window.getFramebufferSize();
-    resolveTexture.assign(0, gl::InternalFormat::RGBA8, size.width, size.height);
-    resolveTexture.setMagFilter(gl::MagFilter::Linear);
-    resolveTexture.setMinFilter(gl::MinFilter::Linear);
-    resolveTexture.setName("G-Buffer Resolution Texture");
-    resolveFramebuffer.attach(gl::ColorAttachment(0), resolveTexture);
-    resolveFramebuffer.setName("G-Buffer Resolution Framebuffer");
 }
 
 void Scene::generateBoxMesh()
 {
     // The random structure
-    std::mt19937 engine(std::random_device{}());
     std::uniform_int_distribution<std::size_t> boxSize(1, 4);
     std::uniform_int_distribution boxStackSize(std::size_t(1), MaxStackedBoxes);
     std::uniform_int_distribution colorChoice(std::size_t(0), BoxColors.size() - 1);
@@ -133,8 +174,8 @@ void Scene::generateBoxMesh()
             stackedBoxes(i - 1, j - 1) = std::max({ stackedBoxes(i - 1, j - 1), val1, val2 });
         }
 
-    // Finally, build the meshes
-    gl::MeshBuilder mesh;
+    // Finally, place the boxes
+    boxes.clear();
 
     for (std::size_t j = 0; j < BoxGridHeight; j++)
         for (std::size_t i = 0; i < BoxGridWidth; i++)
@@ -147,19 +188,201 @@ void Scene::generateBoxMesh()
 
             for (; k < h; k++)
             {
-                auto min = glm::vec3(i, k, j);
-                auto max = min + glm::vec3(1, 1, 1);
-                mesh += meshUtils::addParameters(meshUtils::box(min, max), 
-                    withSpecular(BoxColors[colorChoice(engine)], 0.125), shininess(engine));
+                auto model = glm::translate(glm::mat4(1.0f), glm::vec3(i, k, j));
+                // The shininess is drawn before the color on purpose: the previous code evaluated them in that order,
+                // and keeping it means a given seed still gives the same crates
+                auto boxShininess = shininess(engine);
+                boxes.push_back({ model, withSpecular(BoxColors[colorChoice(engine)], 0.125), boxShininess });
             }
         }
 
-    boxMeshes = mesh;
+    uploadBoxes();
+}
+
+void Scene::generateLocalLights(std::size_t count)
+{
+    std::uniform_real_distribution x(-Bounds, Bounds + BoxGridWidth);
+    std::uniform_real_distribution y(0.25f, MaxStackedBoxes + 1.0f);
+    std::uniform_real_distribution z(-Bounds, Bounds + BoxGridHeight);
+    std::uniform_real_distribution radius(0.75f, 2.0f);
+    std::uniform_real_distribution channel(0.2f, 1.0f);
+    std::uniform_real_distribution tilt(-0.5f, 0.5f);
+    std::uniform_real_distribution coneAngle(0.5f, 0.9f);
+    std::bernoulli_distribution isSpot(0.5);
+
+    std::vector<LocalLight> lights(count);
+    for (auto& light : lights)
+    {
+        light.position.x = x(engine);
+        light.position.y = y(engine);
+        light.position.z = z(engine);
+        light.radius = radius(engine);
+        light.color.r = channel(engine) * LocalLightIntensity;
+        light.color.g = channel(engine) * LocalLightIntensity;
+        light.color.b = channel(engine) * LocalLightIntensity;
+
+        // The spot lights point roughly downwards
+        if (isSpot(engine))
+        {
+            light.direction.x = tilt(engine);
+            light.direction.z = tilt(engine);
+            light.direction = glm::normalize(light.direction);
+
+            auto angle = coneAngle(engine);
+            light.cosOuter = std::cos(angle);
+            light.cosInner = std::cos(0.75f * angle);
+        }
+    }
+
+    lighting.setLocalLights(std::move(lights));
+}
+
+void Scene::addMeshObject(const AABB& bounds, const gl::MeshBuilder& meshBuilder)
+{
+    // The meshes in the arena are drawn together, the others each on its own
+    if (multiDraw) objects.push_back({ bounds, gl::Mesh(), std::nullopt, {}, geometryArena.add(meshBuilder) });
+    else objects.push_back({ bounds, gl::Mesh(meshBuilder), std::nullopt, {}, std::nullopt });
+}
+
+void Scene::uploadStaticObjects()
+{
+    objects.clear();
+    geometryArena.clear();
+    for (const auto& mesh : staticMeshes) addMeshObject(boundsOf(mesh), mesh);
+    numStaticObjects = objects.size();
+}
+
+void Scene::uploadBoxes()
+{
+    // Group the crates in chunks of the grid, so each chunk can be culled on its own
+    constexpr auto ChunksX = (BoxGridWidth + BoxChunkSize - 1) / BoxChunkSize;
+    constexpr auto ChunksZ = (BoxGridHeight + BoxChunkSize - 1) / BoxChunkSize;
+
+    std::vector<std::vector<gl::InstanceSet::Instance>> chunks(ChunksX * ChunksZ);
+    for (const auto& box : boxes)
+    {
+        auto pos = glm::uvec3(box.model[3]);
+        chunks[(pos.z / BoxChunkSize) * ChunksX + pos.x / BoxChunkSize].push_back(box);
+    }
+
+    for (std::size_t i = numStaticObjects; i < objects.size(); i++)
+        if (objects[i].arenaMesh) geometryArena.remove(*objects[i].arenaMesh);
+    objects.resize(numStaticObjects);
+
+    // Mark which levels of each stack are occupied, to find the hidden faces when baking
+    util::grid<std::uint32_t> occupied(BoxGridWidth, BoxGridHeight, std::uint32_t(0));
+    for (const auto& box : boxes)
+    {
+        auto pos = glm::uvec3(box.model[3]);
+        occupied(pos.x, pos.z) |= 1u << pos.y;
+    }
+
+    auto isOccupied = [&](glm::uvec3 pos, glm::ivec3 offset)
+    {
+        auto neighbor = glm::ivec3(pos) + offset;
+        if (neighbor.x < 0 || neighbor.z < 0 || (std::size_t)neighbor.x >= BoxGridWidth || (std::size_t)neighbor.z >= BoxGridHeight) return false;
+        return (occupied(neighbor.x, neighbor.z) & (1u << neighbor.y)) != 0;
+    };
+
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.empty()) continue;
+
+        AABB bounds{ glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+        for (const auto& box : chunk)
+        {
+            auto min = glm::vec3(box.model[3]);
+            bounds = bounds.merge({ min, min + glm::vec3(1, 1, 1) });
+        }
+
+        // Instancing only needs the small per-box buffer, or none at all if the instances are streamed every frame
+        if (instancedBoxes)
+        {
+            gl::InstanceSet instances;
+            if (streamInstances) objects.push_back({ bounds, gl::Mesh(), std::move(instances), chunk, std::nullopt });
+            else
+            {
+                instances.setInstances(chunk);
+                objects.push_back({ bounds, gl::Mesh(), std::move(instances), {}, std::nullopt });
+            }
+            continue;
+        }
+
+        // Otherwise, bake the boxes of the chunk into a single mesh, only with the faces which do not touch another box (or the floor)
+        std::vector<gl::MeshBuilder> boxMeshBuilders;
+        boxMeshBuilders.reserve(chunk.size());
+        for (const auto& box : chunk)
+        {
+            auto pos = glm::uvec3(box.model[3]);
+            auto faces = 0u;
+            if (!isOccupied(pos, glm::ivec3(1, 0, 0))) faces |= meshUtils::BoxFaces::Right;
+            if (!isOccupied(pos, glm::ivec3(-1, 0, 0))) faces |= meshUtils::BoxFaces::Left;
+            if (!isOccupied(pos, glm::ivec3(0, 1, 0))) faces |= meshUtils::BoxFaces::Top;
+            if (pos.y > 0 && !isOccupied(pos, glm::ivec3(0, -1, 0))) faces |= meshUtils::BoxFaces::Bottom;
+            if (!isOccupied(pos, glm::ivec3(0, 0, 1))) faces |= meshUtils::BoxFaces::Front;
+            if (!isOccupied(pos, glm::ivec3(0, 0, -1))) faces |= meshUtils::BoxFaces::Back;
+            if (faces == 0) continue;
+
+            auto min = glm::vec3(pos);
+            boxMeshBuilders.push_back(meshUtils::addParameters(meshUtils::box(min, min + glm::vec3(1, 1, 1), faces), box.color, box.shininess));
+        }
+
+        addMeshObject(bounds, gl::MeshBuilder().append(boxMeshBuilders));
+    }
+
+    // Rebuild the hierarchy over the new set of objects
+    std::vector<AABB> bounds;
+    bounds.reserve(objects.size());
+    for (const auto& object : objects) bounds.push_back(object.bounds);
+    bvh = BVH(bounds);
+
+    // Each run of crates stacked on top of each other makes a single occluder
+    occluderBoxes.clear();
+    for (std::size_t z = 0; z < BoxGridHeight; z++)
+        for (std::size_t x = 0; x < BoxGridWidth; x++)
+        {
+            auto column = occupied(x, z);
+            for (std::uint32_t y = 0; column >> y != 0;)
+            {
+                if (!(column & (1u << y))) { y++; continue; }
+
+                auto top = y;
+                while (column & (1u << top)) top++;
+                occluderBoxes.push_back({ glm::vec3(x, y, z), glm::vec3(x + 1, top, z + 1) });
+                y = top;
+            }
+        }
+
+    // The cached shadows still have the old crates
+    lighting.invalidateShadows();
+}
+
+std::size_t Scene::getBoxTriangleCount() const
+{
+    if (instancedBoxes) return 12 * boxes.size();
+
+    std::size_t count = 0;
+    for (std::size_t i = numStaticObjects; i < objects.size(); i++)
+    {
+        const auto& object = objects[i];
+        count += (object.arenaMesh ? geometryArena.getNumElements(*object.arenaMesh) : object.mesh.getNumElements()) / 3;
+    }
+    return count;
+}
+
+std::size_t Scene::getGeometryMemoryUsage() const
+{
+    auto total = unitBoxMesh.getMemoryUsage() + geometryArena.getMemoryUsage();
+    for (const auto& object : objects)
+    {
+        total += object.mesh.getMemoryUsage();
+        if (object.instances) total += object.instances->getMemoryUsage();
+    }
+    return total;
 }
 
 Scene::~Scene()
 {
-    while (!queries.empty()) queries.pop();
     fullScreenQuad = std::nullopt;
 }
 
@@ -173,34 +396,68 @@ static bool stateChange(bool& lastPress, bool press)
 
 void Scene::update(float delta)
 {
-    camera.update(window, delta);
+    if (!window) return;
+    camera.update(*window, delta);
 
-    if (stateChange(lastPressedSSR, window.getKey('Q')))
+    if (stateChange(lastPressedSSR, window->getKey('Q')))
         enableSSR = !enableSSR;
 
-    if (stateChange(lastPressedRegen, window.getKey('E')))
+    if (stateChange(lastPressedSSRMode, window->getKey('H')))
+        ssrMode = ssrMode == SSRMode::Linear ? SSRMode::HiZ : SSRMode::Linear;
+
+    // Cycles between full, half and quarter resolution
+    if (stateChange(lastPressedSSRScale, window->getKey('G')))
+        ssr.setTraceScale(ssr.getTraceScale() == 4 ? 1 : ssr.getTraceScale() * 2);
+
+    if (stateChange(lastPressedSSRTemporal, window->getKey('F')))
+        ssr.setTemporal(!ssr.isTemporal());
+
+    if (stateChange(lastPressedRegen, window->getKey('E')))
         generateBoxMesh();
 
-    if (stateChange(lastPressedCounters, window.getKey('R')))
+    if (stateChange(lastPressedInstancing, window->getKey('T')))
+        setInstancedBoxes(!instancedBoxes);
+
+    if (stateChange(lastPressedStreamInstances, window->getKey('I')))
+        setStreamedInstances(!streamInstances);
+
+    if (stateChange(lastPressedMultiDraw, window->getKey('M')))
+        setMultiDraw(!multiDraw);
+
+    if (stateChange(lastPressedLights, window->getKey('L')))
+        generateLocalLights(lighting.getNumLocalLights() == 0 ? DefaultLocalLights : 0);
+
+    if (stateChange(lastPressedClustered, window->getKey('C')))
+        lighting.setClustered(!lighting.isClustered());
+
+    if (stateChange(lastPressedOcclusion, window->getKey('O')))
+        occlusionCulling = !occlusionCulling;
+
+    if (stateChange(lastPressedFused, window->getKey('P')))
+        fusedComposite = !fusedComposite;
+
+    if (stateChange(lastPressedGBufferLayout, window->getKey('B')))
+        gbuffer.setLayout(gbuffer.getLayout() == GBufferLayout::Wide ? GBufferLayout::Compact : GBufferLayout::Wide);
+
+    if (stateChange(lastPressedCounters, window->getKey('R')))
         showCounters = !showCounters;
 }
 
-void Scene::getQueryResults()
+void Scene::followCameraPath(float t)
 {
-    while (!queries.empty())
-    {
-        auto& q = queries.front();
-        if (q.gbuffer.available() && q.shadow.available() && q.resolve.available() && q.ssr.available() && q.finalStep.available())
-        {
-            lastResults.gbuffer = q.gbuffer.result();
-            lastResults.shadow = q.shadow.result();
-            lastResults.resolve = q.resolve.result();
-            lastResults.ssr = q.ssr.result();
-            lastResults.finalStep = q.finalStep.result();
-            queries.pop();
-        }
-        else break;
-    }
+    // Orbit around the crates at the initial camera's distance and height, t = 1 being a full turn
+    constexpr float Pi = 3.14159265359f;
+    constexpr auto offset = InitialPos - ViewPos;
+    auto radius = std::sqrt(offset.x * offset.x + offset.z * offset.z);
+    auto angle = 2 * Pi * t;
+
+    camera.position = ViewPos + glm::vec3(radius * std::sin(angle), offset.y, radius * std::cos(angle));
+    camera.lookAt(ViewPos);
+}
+
+void Scene::setViewport() const
+{
+    gl::StateCache::viewport(0, 0, size.width, size.height);
 }
 
 void Scene::draw()
@@ -209,84 +466,262 @@ void Scene::draw()
 
     const auto& view = camera.getViewMatrix();
 
-    auto& q = queries.emplace();
+    profiler.beginFrame();
+    geometryArena.resetStats();
+
+    // The streamed instances are written again every frame, which both the camera and the shadows draw
+    for (auto& object : objects)
+        if (object.instances && !object.streamedInstances.empty()) object.instances->streamInstances(streamBuffer, object.streamedInstances);
+
+    // Every pass declares what it reads and writes, then the graph runs the ones the output depends on
+    frameGraph.reset();
+
+    // The occluders are rasterized on the CPU, so time them there
+    lastOcclusionTime = 0;
+    auto occlusionPass = frameGraph.addPass("Occluder Rasterization");
+    auto occluders = occlusionPass.write(frameGraph.import("Occlusion Buffer"));
+    occlusionPass.setExecute([&](FrameGraph&)
+    {
+        auto then = std::chrono::high_resolution_clock::now();
+        rasterizeOccluders(camera.projection * view);
+        lastOcclusionTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - then).count();
+    });
 
     // Draw scene to g-buffer
-    q.gbuffer.begin();
-    gbuffer.begin();
-    drawScene(camera.projection, view, gbuffer.getDrawProgram());
-    gbuffer.end();
-    q.gbuffer.end();
+    auto gbufferPass = frameGraph.addPass("G-Buffer", GBufferZone);
+    if (occlusionCulling) gbufferPass.read(occluders);
+    auto gbufferTargets = gbuffer.createTargets(gbufferPass);
+    gbufferPass.setExecute([&](FrameGraph& graph)
+    {
+        gbuffer.begin(graph, gbufferTargets);
+        lastCameraCulling = drawScene(camera.projection, view, gbuffer.getDrawProgram(), occlusionCulling ? &occlusionBuffer : nullptr);
+        gbuffer.end();
+    });
 
     // Draw scene with shadow
-    q.shadow.begin();
-    lighting.beginShadow();
-    drawScene(lighting.getShadowProjection(), glm::mat4(1.0f), *shadowProgram);
-    lighting.endShadow();
-    q.shadow.end();
+    auto shadowPass = frameGraph.addPass("Shadow Cascades");
+    auto shadowCascades = shadowPass.write(frameGraph.import("Shadow Cascades"));
+    shadowPass.setExecute([&](FrameGraph&)
+    {
+        lighting.fitShadowCascades(camera.projection, view);
+        lastShadowCulling = {};
+        lastShadowCascadesDrawn = 0;
+
+        // An empty pass still takes a little time, so the zone only starts with the first cascade drawn
+        std::optional<GpuProfiler::Scope> zone;
+        for (int i = 0; i < NumShadowCascades; i++)
+        {
+            // Only the cascades which moved, or whose contents changed, are drawn again
+            if (!lighting.needsShadowUpdate(i)) continue;
+            if (!zone) zone.emplace(profiler, ShadowZone);
+            GpuProfiler::Scope cascadeZone(profiler, "Shadow Cascade " + std::to_string(i));
+
+            lighting.beginShadow(i);
+            auto culling = drawScene(lighting.getShadowProjection(i), glm::mat4(1.0f), *shadowProgram);
+            lastShadowCulling.visible += culling.visible;
+            lastShadowCulling.culled += culling.culled;
+            lastShadowCascadesDrawn++;
+        }
+        lighting.endShadow();
+    });
+
+    auto clusterPass = frameGraph.addPass("Light Clusters");
+    auto lightClusters = clusterPass.write(frameGraph.import("Light Clusters"));
+    clusterPass.setExecute([&](FrameGraph&) { lighting.buildLightClusters(streamBuffer, camera.projection, view); });
 
     // Resolve the lighting
-    glDisable(GL_DEPTH_TEST); gl::checkError();
-    q.resolve.begin();
-    resolveGBuffer(view);
-    q.resolve.end();
+    auto resolvePass = frameGraph.addPass("Lighting Resolution", ResolveZone);
+    gbuffer.readTargets(resolvePass, gbufferTargets);
+    resolvePass.read(shadowCascades);
+    resolvePass.read(lightClusters);
+    auto resolve = resolvePass.create("Resolve", { gl::InternalFormat::RGBA8, size.width, size.height });
+    resolvePass.setExecute([&](FrameGraph& graph)
+    {
+        gl::StateCache::disable(GL_DEPTH_TEST);
+        resolveGBuffer(graph.getFramebuffer({ resolve }), view);
+    });
+
+    // Add the local lights on top
+    auto localLightsPass = frameGraph.addPass("Tiled Local Lighting", LocalLightsZone);
+    gbuffer.readTargets(localLightsPass, gbufferTargets);
+    auto litResolve = localLightsPass.write(resolve);
+    localLightsPass.setExecute([&](FrameGraph& graph)
+    {
+        lighting.shadeLocalLights(streamBuffer, gbuffer, graph.getTexture(litResolve), camera.projection, view, size.width, size.height);
+    });
+
+    // Compute the screen-space reflections, which are culled when nothing reads them
+    auto reflections = ssr.addPasses(frameGraph, gbuffer, gbufferTargets, litResolve, camera.projection, view, ssrMode, SSRZone);
+    if (!enableSSR) ssr.skipFrame();
+
+    // The final step, in the same pass as the reflections if they are fused
+    auto fused = fusedComposite && ssr.canComposite(ssrMode);
+    auto output = frameGraph.import("Output");
+    if (fused)
+    {
+        auto compositePass = frameGraph.addPass("SSR Composite", SSRZone);
+        gbuffer.readTargets(compositePass, gbufferTargets);
+        compositePass.read(litResolve);
+        auto composite = compositePass.create("Composite", { gl::InternalFormat::RGBA8, size.width, size.height });
+        compositePass.setExecute([&, composite](FrameGraph& graph)
+        {
+            ssr.drawComposite(gbuffer, graph.getTexture(litResolve), graph.getTexture(composite), camera.projection, enableSSR);
+        });
+
+        auto copyPass = frameGraph.addPass("Composite Copy", FinalStepZone);
+        copyPass.read(composite);
+        output = copyPass.write(output);
+        copyPass.setExecute([&, composite](FrameGraph& graph)
+        {
+            // Whatever is drawn after the scene goes on top of the output
+            graph.getFramebuffer({ composite }).blitTo(outputFramebuffer, size.width, size.height);
+            bindOutputFramebuffer();
+        });
+    }
+    else
+    {
+        auto finalPass = frameGraph.addPass("Final Step", FinalStepZone);
+        gbuffer.readTargets(finalPass, gbufferTargets);
+        finalPass.read(litResolve);
+        if (enableSSR) ssr.readTargets(finalPass, reflections);
+        output = finalPass.write(output);
+        finalPass.setExecute([&](FrameGraph& graph) { finalStep(graph, litResolve, enableSSR ? &reflections : nullptr); });
+    }
+
+    frameGraph.markOutput(output);
+    frameGraph.compile();
+    frameGraph.execute(profiler);
+    profiler.endFrame();
+    streamBuffer.endFrame();
+    lastArenaStats = geometryArena.getStats();
 
-    // Compute the screen-space reflections
-    q.ssr.begin();
-    if (enableSSR) ssr.drawSSR(gbuffer, camera.projection);
-    else ssr.clearSSR();
-    q.ssr.end();
+    // Without reflections, the final step only copies the lighting
+    if (fused || !enableSSR) lastCompositeStats = { 1, 0 };
+    else lastCompositeStats = { std::size_t(2 + ssr.isTemporal() + (ssrMode == SSRMode::HiZ)), ssr.getIntermediateBytes() };
 
-    // The final step
-    q.finalStep.begin();
-    finalStep();
-    q.finalStep.end();
+    gl::StateCache::enable(GL_DEPTH_TEST);
 
-    glEnable(GL_DEPTH_TEST); gl::checkError();
+    // Count the state changes of a whole frame
+    lastStateCounters = gl::StateCache::getCounters();
+    gl::StateCache::resetCounters();
+}
+
+// The walls and the floor are flat, so their bounds are their quads
+static std::array<glm::vec3, 4> flatQuad(const AABB& bounds)
+{
+    const auto& min = bounds.min;
+    const auto& max = bounds.max;
+    if (min.x == max.x) return { min, glm::vec3(min.x, max.y, min.z), max, glm::vec3(min.x, min.y, max.z) };
+    if (min.y == max.y) return { min, glm::vec3(max.x, min.y, min.z), max, glm::vec3(min.x, min.y, max.z) };
+    return { min, glm::vec3(max.x, min.y, min.z), max, glm::vec3(min.x, max.y, min.z) };
+}
 
-    drawGui();
+void Scene::rasterizeOccluders(const glm::mat4& viewProjection)
+{
+    occlusionBuffer.clear(viewProjection);
+    for (std::size_t i = 0; i < numStaticObjects; i++)
+        occlusionBuffer.addQuad(flatQuad(objects[i].bounds));
+    for (const auto& box : occluderBoxes)
+        occlusionBuffer.addBox(box.min, box.max);
+    occlusionBuffer.rasterize();
 }
 
-void scene::Scene::drawScene(const glm::mat4& projection, const glm::mat4& view, gl::Program& program)
+Scene::CullingStats scene::Scene::drawScene(const glm::mat4& projection, const glm::mat4& view, gl::Program& program, const OcclusionBuffer* occlusion)
 {
     program.use();
     program.setUniform("Projection", projection);
     program.setUniform("View", view);
 
-    // Draw the floor and the cubes
-    floorMesh.draw(glm::mat4(1.0f));
-    boxMeshes.draw(glm::mat4(1.0f));
+    // Only draw the objects inside the view frustum
+    visibleObjects.clear();
+    auto culled = bvh.cull(util::frustumPlanes(projection * view), visibleObjects);
+    std::sort(visibleObjects.begin(), visibleObjects.end());
+
+    // And not hidden behind the occluders
+    std::size_t occluded = 0;
+    if (occlusion)
+    {
+        occluded = std::erase_if(visibleObjects, [&](std::size_t i) { return !occlusion->isVisible(objects[i].bounds.min, objects[i].bounds.max); });
+    }
+
+    for (auto i : visibleObjects)
+    {
+        const auto& object = objects[i];
+        if (object.arenaMesh) { geometryArena.queue(*object.arenaMesh); continue; }
+
+        // The meshes of the arena queued before are drawn first, so the objects are still drawn in order
+        geometryArena.submit(streamBuffer);
+        if (object.instances) unitBoxMesh.draw(*object.instances);
+        else object.mesh.draw(glm::mat4(1.0f));
+    }
+    geometryArena.submit(streamBuffer);
+
+    return { visibleObjects.size(), culled, occluded };
+}
+
+std::size_t Scene::checkLightBinning() const
+{
+    std::vector<float> depth(std::size_t(size.width) * size.height);
+    gbuffer.getDepthTexture().getImage(0, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data(), depth.size() * sizeof(float));
+
+    auto spheres = lighting.getLightSpheres(camera.getViewMatrix());
+    auto expected = binLights(spheres, depth, size.width, size.height, camera.projection);
+    auto actual = lighting.readLightTiles();
+
+    // The compute shader adds the lights in any order
+    std::size_t mismatches = 0;
+    for (int ty = 0; ty < expected.tilesY; ty++)
+        for (int tx = 0; tx < expected.tilesX; tx++)
+        {
+            auto lights = actual.lights(tx, ty);
+            std::vector<std::uint32_t> sorted(lights.begin(), lights.end());
+            std::sort(sorted.begin(), sorted.end());
+
+            // Which lights make it into a full tile is arbitrary, so only the counts can be compared then
+            auto full = expected.count(tx, ty) > MaxLightsPerTile;
+            if (expected.count(tx, ty) != actual.count(tx, ty) || (!full && !std::ranges::equal(sorted, expected.lights(tx, ty))))
+                mismatches++;
+        }
+
+    return mismatches;
 }
 
-void Scene::resolveGBuffer(const glm::mat4& view)
+void Scene::resolveGBuffer(const gl::Framebuffer& framebuffer, const glm::mat4& view)
 {
-    resolveFramebuffer.bind();
-    window.setViewport();
+    framebuffer.bind();
+    setViewport();
     glClearColor(0.0, 0.0, 0.0, 0.0); gl::checkError();
     glClear(GL_COLOR_BUFFER_BIT); gl::checkError();
 
     resolveProgram->use();
     gbuffer.setParams(*resolveProgram, camera.projection);
-    resolveProgram->setUniform("InvViewShadowViewProjection", lighting.getShadowProjection() * glm::inverse(view));
 
     lighting.setLightParams(*resolveProgram, view);
     lighting.setShadowMapTexture(*resolveProgram);
+    lighting.setClusterParams(*resolveProgram);
 
     // Draw the fullscreen quad
     drawFullScreenQuad();
 }
 
-void Scene::finalStep()
+void Scene::bindOutputFramebuffer()
+{
+    if (outputFramebuffer) outputFramebuffer->bind();
+    else gl::Framebuffer::bindDefault();
+    setViewport();
+}
+
+void Scene::finalStep(const FrameGraph& graph, FrameGraph::Resource resolve, const SSRTargets* reflections)
 {
-    gl::Framebuffer::bindDefault();
-    window.setViewport();
+    bindOutputFramebuffer();
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT); gl::checkError();
 
     ssrDrawProgram->use();
-    resolveTexture.bindTo(0);
+    graph.getTexture(resolve).bindTo(0);
     ssrDrawProgram->setUniform("ResolveTexture", 0);
-    ssr.setTextureParam(*ssrDrawProgram);
+    ssr.setTextureParam(*ssrDrawProgram, graph, reflections);
+    gbuffer.setParams(*ssrDrawProgram, camera.projection);
     drawFullScreenQuad();
 }
 
@@ -297,18 +732,47 @@ void Scene::drawGui()
     ImGui::Begin("Details Window", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize);
     ImGui::Text("WASD to move around, move mouse to move camera");
     ImGui::Text("Q to %s screen space reflections", enableSSR ? "disable" : "enable");
+    ImGui::Text("H to switch the reflections to the %s tracer", ssrMode == SSRMode::Linear ? "Hi-Z" : "linear");
+    ImGui::Text("G to change the resolution of the reflections (now 1/%d)", ssr.getTraceScale());
+    ImGui::Text("F to %s the temporal reuse of the reflections", ssr.isTemporal() ? "disable" : "enable");
+    ImGui::Text("L to %s the local lights", lighting.getNumLocalLights() == 0 ? "add" : "remove");
+    ImGui::Text("C to shade the local lights %s", lighting.isClustered() ? "by screen tiles" : "by clusters built on the CPU");
+    ImGui::Text("O to %s the occlusion culling", occlusionCulling ? "disable" : "enable");
+    ImGui::Text("P to %s the reflections and the final step in one compute pass", fusedComposite ? "split" : "fuse");
+    ImGui::Text("B to switch to the %s G-buffer layout", gbuffer.getLayout() == GBufferLayout::Wide ? "compact" : "wide");
     ImGui::Text("E to regenerate the crates");
+    ImGui::Text("T to %s instancing for the crates", instancedBoxes ? "disable" : "enable");
+    ImGui::Text("I to %s the instances of the crates every frame", streamInstances ? "stop streaming" : "stream");
+    ImGui::Text("M to draw the meshes %s", multiDraw ? "each on its own" : "together from a single arena");
     ImGui::Text("R to %s the performance counters", showCounters ? "hide" : "show");
     ImGui::End();
 
     if (showCounters)
     {
         ImGui::Begin("Counters", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize);
-        ImGui::Text("G-Buffer Construction: %.3lfms", lastResults.gbuffer / 1000000.0);
-        ImGui::Text("Shadow Map Generation: %.3lfms", lastResults.shadow / 1000000.0);
-        ImGui::Text("Lighting Resolution: %.3lfms", lastResults.resolve / 1000000.0);
-        ImGui::Text("SSR Buffers Constuction: %.3lfms", lastResults.ssr / 1000000.0);
-        ImGui::Text("Final Combine Step: %.3lfms", lastResults.finalStep / 1000000.0);
+        for (const auto& zone : profiler.getLastZones())
+            ImGui::Text("%*s%s: %.3lfms", int(2 * zone.depth), "", zone.name.c_str(), zone.time / 1000000.0);
+        auto traffic = measureGBufferTraffic(gbuffer.getLayout());
+        ImGui::Text("G-Buffer Bytes/Pixel: %zu written, %zu read by the resolve, %zu by each reflection, %zu by each upsampling tap",
+            traffic.written, traffic.resolveRead, traffic.ssrRead, traffic.ssrNormalRead);
+        ImGui::Text("Light Cluster Assignment (CPU): %.3lfms", lighting.getLastClusterTime());
+        ImGui::Text("Composite Passes: %zu, with %.1lfKiB of intermediate textures", lastCompositeStats.passes,
+            lastCompositeStats.intermediateBytes / 1024.0);
+        const auto& graph = frameGraph.getStats();
+        ImGui::Text("Frame Graph: %zu passes, %zu culled, %zu transient textures in %zu", graph.passes, graph.culledPasses,
+            graph.transientTextures, graph.physicalTextures);
+        ImGui::Text("Render Targets: %.1lfKiB each on its own, %.1lfKiB allocated", graph.unaliasedBytes / 1024.0,
+            graph.allocatedBytes / 1024.0);
+        ImGui::Text("GL State Changes: %zu issued, %zu elided", lastStateCounters.issued, lastStateCounters.elided);
+        ImGui::Text("Arena Meshes: %zu draws in %zu multi-draw calls", lastArenaStats.draws, lastArenaStats.submits);
+        const auto& stream = streamBuffer.getStats();
+        ImGui::Text("Stream Buffer: %.1lfKiB this frame of %.1lfKiB, %zu wraps, %zu stalls in %.3lfms", streamBuffer.getLastFrameBytes() / 1024.0,
+            streamBuffer.getCapacity() / 1024.0, stream.wraps, stream.stalls, stream.stallTime);
+        ImGui::Text("Camera Objects: %zu visible, %zu culled, %zu occluded", lastCameraCulling.visible, lastCameraCulling.culled,
+            lastCameraCulling.occluded);
+        ImGui::Text("Occluder Rasterization (CPU): %.3lfms", lastOcclusionTime);
+        ImGui::Text("Shadow Objects: %zu visible, %zu culled", lastShadowCulling.visible, lastShadowCulling.culled);
+        ImGui::Text("Shadow Cascades Drawn: %zu of %d", lastShadowCascadesDrawn, NumShadowCascades);
         ImGui::End();
     }
 }
@@ -2,28 +2,77 @@
 
 #include "wrappers/glfw.hpp"
 #include "resources/Mesh.hpp"
+#include "resources/InstanceSet.hpp"
+#include "resources/StreamBuffer.hpp"
+#include "resources/GeometryArena.hpp"
 #include "resources/Program.hpp"
 #include "GBuffer.hpp"
 #include "SSR.hpp"
 #include "Camera.hpp"
 #include "Lighting.hpp"
-#include "resources/Query.hpp"
+#include "BVH.hpp"
+#include "OcclusionBuffer.hpp"
+#include "FrameGraph.hpp"
+#include "GpuProfiler.hpp"
+#include "resources/StateCache.hpp"
 
-#include <queue>
+#include <random>
+#include <optional>
 
 namespace scene
 {
     class Scene final
     {
-        glfw::Window& window;
+        glfw::Window* window;
+        glfw::Size size;
+        const gl::Framebuffer* outputFramebuffer;
         Camera camera;
         Lighting lighting;
         GBuffer gbuffer;
-        gl::Mesh floorMesh;
-        gl::Mesh boxMeshes;
 
-        gl::Texture2D resolveTexture;
-        gl::Framebuffer resolveFramebuffer;
+        // The data which changes every frame is written to a ring of mapped memory
+        gl::StreamBuffer streamBuffer;
+
+        // The static meshes can share the buffers of an arena, so they are all drawn by a few calls
+        gl::GeometryArena geometryArena;
+        bool multiDraw;
+        bool lastPressedMultiDraw;
+
+        // Either a mesh, possibly in the arena, or instances of the unit box, which are kept here when they
+        // are streamed every frame
+        struct SceneObject
+        {
+            AABB bounds;
+            gl::Mesh mesh;
+            std::optional<gl::InstanceSet> instances;
+            std::vector<gl::InstanceSet::Instance> streamedInstances;
+            std::optional<gl::GeometryArena::Handle> arenaMesh;
+        };
+
+        // The floor and the walls come first, then the chunks of crates
+        std::vector<gl::MeshBuilder> staticMeshes;
+        std::vector<SceneObject> objects;
+        std::size_t numStaticObjects;
+        BVH bvh;
+        std::vector<std::size_t> visibleObjects;
+
+        // The stacks of crates, merged into tall boxes, and the floor and the walls hide the objects behind them
+        OcclusionBuffer occlusionBuffer;
+        std::vector<AABB> occluderBoxes;
+        bool occlusionCulling;
+        bool lastPressedOcclusion;
+        double lastOcclusionTime;
+
+        // The crates can also be drawn as instances of a single unit box
+        gl::Mesh unitBoxMesh;
+        std::vector<gl::InstanceSet::Instance> boxes;
+
+        // The passes of each frame, which also own the textures that only live during a frame
+        FrameGraph frameGraph;
+
+        // The reflections and the final step can be fused into a compute pass, which writes to a texture copied to the output
+        bool fusedComposite;
+        bool lastPressedFused;
         std::shared_ptr<gl::Program> resolveProgram;
 
         std::shared_ptr<gl::Program> objectProgram;
@@ -35,35 +84,106 @@ namespace scene
         bool enableSSR;
         bool lastPressedSSR;
 
+        SSRMode ssrMode;
+        bool lastPressedSSRMode;
+
+        bool lastPressedSSRScale;
+        bool lastPressedSSRTemporal;
+
         bool showCounters;
         bool lastPressedCounters;
 
         bool lastPressedRegen;
 
-        struct Queries 
-        { 
-            gl::Query gbuffer, shadow, resolve, ssr, finalStep;
-            Queries() : gbuffer(gl::QueryType::TimeElapsed), shadow(gl::QueryType::TimeElapsed), resolve(gl::QueryType::TimeElapsed), 
-                ssr(gl::QueryType::TimeElapsed), finalStep(gl::QueryType::TimeElapsed) {}
-        };
-        struct Results { GLuint64 gbuffer, shadow, resolve, ssr, finalStep; };
+        bool instancedBoxes;
+        bool lastPressedInstancing;
+        bool streamInstances;
+        bool lastPressedStreamInstances;
 
-        std::queue<Queries> queries;
-        Results lastResults;
+        bool lastPressedLights;
+        bool lastPressedClustered;
+        bool lastPressedGBufferLayout;
+
+        std::mt19937 engine;
+
+    public:
+        // The zones of the profiler for each part of the frame
+        static constexpr auto GBufferZone = "G-Buffer Construction";
+        static constexpr auto ShadowZone = "Shadow Map Generation";
+        static constexpr auto ResolveZone = "Lighting Resolution";
+        static constexpr auto LocalLightsZone = "Tiled Local Lighting";
+        static constexpr auto SSRZone = "SSR Buffers Construction";
+        static constexpr auto FinalStepZone = "Final Combine Step";
+
+        struct CullingStats { std::size_t visible, culled, occluded = 0; };
+
+        // From the resolved lighting to the output: the passes which shade the screen, not counting the
+        // final copy of the fused pass, and the bytes of the intermediate textures between them
+        struct CompositeStats { std::size_t passes, intermediateBytes; };
+
+    private:
+        GpuProfiler profiler;
+        gl::StateCounters lastStateCounters;
+        CullingStats lastCameraCulling, lastShadowCulling;
+        std::size_t lastShadowCascadesDrawn;
+        CompositeStats lastCompositeStats;
+        gl::GeometryArena::Stats lastArenaStats;
+
+        Scene(glfw::Window* window, glfw::Size size, const gl::Framebuffer* outputFramebuffer, std::uint32_t seed);
+        void setViewport() const;
+        void addMeshObject(const AABB& bounds, const gl::MeshBuilder& meshBuilder);
+        void uploadStaticObjects();
+        void bindOutputFramebuffer();
 
     public:
         Scene(glfw::Window& window);
+        // Headless scene: the final image goes to outputFramebuffer instead of the default one,
+        // and the crates are generated from a fixed seed so runs can be compared
+        Scene(glfw::Size size, const gl::Framebuffer& outputFramebuffer, std::uint32_t seed);
         ~Scene();
 
         void generateBoxMesh();
+        void generateLocalLights(std::size_t count);
+        void uploadBoxes();
 
         void update(float delta);
-
-        void getQueryResults();
+        void followCameraPath(float t);
+        void setSSREnabled(bool enabled) { enableSSR = enabled; }
+        void setSSRMode(SSRMode mode) { ssrMode = mode; }
+        void setSSRScale(int scale) { ssr.setTraceScale(scale); }
+        void setSSRTemporal(bool enabled) { ssr.setTemporal(enabled); }
+        void setClusteredLights(bool enabled) { lighting.setClustered(enabled); }
+
+        // Returns the number of tiles whose lights differ from the CPU binning in the last frame
+        std::size_t checkLightBinning() const;
+        void setInstancedBoxes(bool enabled) { instancedBoxes = enabled; uploadBoxes(); }
+        void setStreamedInstances(bool enabled) { streamInstances = enabled; uploadBoxes(); }
+        void setMultiDraw(bool enabled) { multiDraw = enabled; uploadStaticObjects(); uploadBoxes(); }
+        void setGBufferLayout(GBufferLayout layout) { gbuffer.setLayout(layout); }
+        auto getGBufferLayout() const { return gbuffer.getLayout(); }
+        void setOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+        void setFusedComposite(bool enabled) { fusedComposite = enabled; }
+
+        // Reads back the timings of the frames which the GPU finished
+        void getQueryResults() { profiler.collect(); }
+        const GpuProfiler& getProfiler() const { return profiler; }
+        const gl::StateCounters& getLastStateCounters() const { return lastStateCounters; }
+        double getLastClusterTime() const { return lighting.getLastClusterTime(); }
+        const CullingStats& getLastCameraCulling() const { return lastCameraCulling; }
+        const CullingStats& getLastShadowCulling() const { return lastShadowCulling; }
+        std::size_t getLastShadowCascadesDrawn() const { return lastShadowCascadesDrawn; }
+        double getLastOcclusionTime() const { return lastOcclusionTime; }
+        const CompositeStats& getLastCompositeStats() const { return lastCompositeStats; }
+        const FrameGraph::Stats& getLastFrameGraphStats() const { return frameGraph.getStats(); }
+        const gl::StreamBuffer& getStreamBuffer() const { return streamBuffer; }
+        const gl::GeometryArena::Stats& getLastArenaStats() const { return lastArenaStats; }
+        std::size_t getBoxTriangleCount() const;
+        std::size_t getGeometryMemoryUsage() const;
         void draw();
-        void drawScene(const glm::mat4& projection, const glm::mat4& view, gl::Program& program);
-        void resolveGBuffer(const glm::mat4& view);
-        void finalStep();
+        void rasterizeOccluders(const glm::mat4& viewProjection);
+        CullingStats drawScene(const glm::mat4& projection, const glm::mat4& view, gl::Program& program, const OcclusionBuffer* occlusion = nullptr);
+        void resolveGBuffer(const gl::Framebuffer& framebuffer, const glm::mat4& view);
+        void finalStep(const FrameGraph& graph, FrameGraph::Resource resolve, const SSRTargets* reflections);
         void drawGui();
 
         static void drawFullScreenQuad();
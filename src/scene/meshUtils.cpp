@@ -105,71 +105,37 @@ gl::MeshBuilder meshUtils::planeBack(float z, float xmin, float ymin, float xmax
     return planeZ(z, xmin, ymin, xmax, ymax, false);
 }
 
-gl::MeshBuilder meshUtils::box(glm::vec3 min, glm::vec3 max)
+gl::MeshBuilder meshUtils::box(glm::vec3 min, glm::vec3 max, unsigned int faces)
 {
     gl::MeshBuilder mesh;
 
-    // Generate the vertices: we need 24 vertices in order to get all the correct places
+    // Generate the vertices: we need 4 vertices per face in order to get all the correct normals
     mesh.positions.reserve(24);
     mesh.normals.reserve(24);
-
-    // For each one of the 6 faces, we insert the normal 4 times
-    for (auto normal : { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
-        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) })
-    {
-        mesh.normals.push_back(normal);
-        mesh.normals.push_back(normal);
-        mesh.normals.push_back(normal);
-        mesh.normals.push_back(normal);
-    }
-
-    // Now, we do the positions manually - right face
-    mesh.positions.emplace_back(max.x, min.y, min.z);
-    mesh.positions.emplace_back(max.x, max.y, min.z);
-    mesh.positions.emplace_back(max.x, max.y, max.z);
-    mesh.positions.emplace_back(max.x, min.y, max.z);
-
-    // left face
-    mesh.positions.emplace_back(min.x, min.y, min.z);
-    mesh.positions.emplace_back(min.x, min.y, max.z);
-    mesh.positions.emplace_back(min.x, max.y, max.z);
-    mesh.positions.emplace_back(min.x, max.y, min.z);
-
-    // top face
-    mesh.positions.emplace_back(min.x, max.y, min.z);
-    mesh.positions.emplace_back(min.x, max.y, max.z);
-    mesh.positions.emplace_back(max.x, max.y, max.z);
-    mesh.positions.emplace_back(max.x, max.y, min.z);
-
-    // bottom face
-    mesh.positions.emplace_back(min.x, min.y, min.z);
-    mesh.positions.emplace_back(max.x, min.y, min.z);
-    mesh.positions.emplace_back(max.x, min.y, max.z);
-    mesh.positions.emplace_back(min.x, min.y, max.z);
-
-    // front face
-    mesh.positions.emplace_back(min.x, min.y, max.z);
-    mesh.positions.emplace_back(max.x, min.y, max.z);
-    mesh.positions.emplace_back(max.x, max.y, max.z);
-    mesh.positions.emplace_back(min.x, max.y, max.z);
-
-    // back face
-    mesh.positions.emplace_back(min.x, min.y, min.z);
-    mesh.positions.emplace_back(min.x, max.y, min.z);
-    mesh.positions.emplace_back(max.x, max.y, min.z);
-    mesh.positions.emplace_back(max.x, min.y, min.z);
-
-    // Topology
     mesh.indices.reserve(36);
-    for (std::size_t i = 0; i < 6; i++)
+
+    auto addFace = [&](unsigned int face, glm::vec3 normal, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3)
     {
-        mesh.indices.push_back((unsigned int)(4 * i + 0));
-        mesh.indices.push_back((unsigned int)(4 * i + 1));
-        mesh.indices.push_back((unsigned int)(4 * i + 2));
-        mesh.indices.push_back((unsigned int)(4 * i + 0));
-        mesh.indices.push_back((unsigned int)(4 * i + 2));
-        mesh.indices.push_back((unsigned int)(4 * i + 3));
-    }
+        if (!(faces & face)) return;
+
+        auto base = (std::uint32_t)mesh.positions.size();
+        mesh.positions.insert(mesh.positions.end(), { p0, p1, p2, p3 });
+        mesh.normals.insert(mesh.normals.end(), 4, normal);
+        mesh.indices.insert(mesh.indices.end(), { base + 0, base + 1, base + 2, base + 0, base + 2, base + 3 });
+    };
+
+    addFace(BoxFaces::Right, glm::vec3(1, 0, 0), glm::vec3(max.x, min.y, min.z), glm::vec3(max.x, max.y, min.z),
+        glm::vec3(max.x, max.y, max.z), glm::vec3(max.x, min.y, max.z));
+    addFace(BoxFaces::Left, glm::vec3(-1, 0, 0), glm::vec3(min.x, min.y, min.z), glm::vec3(min.x, min.y, max.z),
+        glm::vec3(min.x, max.y, max.z), glm::vec3(min.x, max.y, min.z));
+    addFace(BoxFaces::Top, glm::vec3(0, 1, 0), glm::vec3(min.x, max.y, min.z), glm::vec3(min.x, max.y, max.z),
+        glm::vec3(max.x, max.y, max.z), glm::vec3(max.x, max.y, min.z));
+    addFace(BoxFaces::Bottom, glm::vec3(0, -1, 0), glm::vec3(min.x, min.y, min.z), glm::vec3(max.x, min.y, min.z),
+        glm::vec3(max.x, min.y, max.z), glm::vec3(min.x, min.y, max.z));
+    addFace(BoxFaces::Front, glm::vec3(0, 0, 1), glm::vec3(min.x, min.y, max.z), glm::vec3(max.x, min.y, max.z),
+        glm::vec3(max.x, max.y, max.z), glm::vec3(min.x, max.y, max.z));
+    addFace(BoxFaces::Back, glm::vec3(0, 0, -1), glm::vec3(min.x, min.y, min.z), glm::vec3(min.x, max.y, min.z),
+        glm::vec3(max.x, max.y, min.z), glm::vec3(max.x, min.y, min.z));
 
     return mesh;
 }
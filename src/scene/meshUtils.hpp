@@ -5,13 +5,23 @@
 
 namespace meshUtils
 {
+    // Flags to select which faces of a box are generated
+    namespace BoxFaces
+    {
+        enum : unsigned int
+        {
+            Right = 1, Left = 2, Top = 4, Bottom = 8, Front = 16, Back = 32,
+            All = Right | Left | Top | Bottom | Front | Back
+        };
+    }
+
     gl::MeshBuilder planeRight(float x, float ymin, float zmin, float ymax, float zmax);
     gl::MeshBuilder planeLeft(float x, float ymin, float zmin, float ymax, float zmax);
     gl::MeshBuilder planeUp(float y, float xmin, float zmin, float xmax, float zmax);
     gl::MeshBuilder planeDown(float y, float xmin, float zmin, float xmax, float zmax);
     gl::MeshBuilder planeFront(float z, float xmin, float ymin, float xmax, float ymax);
     gl::MeshBuilder planeBack(float z, float xmin, float ymin, float xmax, float ymax);
-    gl::MeshBuilder box(glm::vec3 min, glm::vec3 max);
+    gl::MeshBuilder box(glm::vec3 min, glm::vec3 max, unsigned int faces = BoxFaces::All);
     gl::MeshBuilder addParameters(gl::MeshBuilder&& mesh, glm::u8vec4 color, float shininess);
 
     void swapWinding(gl::MeshBuilder& mesh);
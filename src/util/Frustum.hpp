@@ -2,38 +2,151 @@
 
 #include <glm/glm.hpp>
 #include <algorithm>
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define FRUSTUM_SIMD
+#endif
 
 namespace util
 {
-    // Check the minimum plane distance for an AABB
-    float planeDistanceAABB(const glm::vec4& plane, const glm::vec3& min, const glm::vec3& max)
+    // Check the maximum plane distance for an AABB
+    inline float planeDistanceAABB(const glm::vec4& plane, const glm::vec3& min, const glm::vec3& max)
     {
-        // Since the distance function is linear (thus continuous and monotonic), it attains
-        // its minimum at the vertices of the AABB (which is convex), so we only need to test those
-        return std::max({
-            glm::dot(plane, glm::vec4(min.x, min.y, min.z, 1)),
-            glm::dot(plane, glm::vec4(max.x, min.y, min.z, 1)),
-            glm::dot(plane, glm::vec4(min.x, max.y, min.z, 1)),
-            glm::dot(plane, glm::vec4(max.x, max.y, min.z, 1)),
-            glm::dot(plane, glm::vec4(min.x, min.y, max.z, 1)),
-            glm::dot(plane, glm::vec4(max.x, min.y, max.z, 1)),
-            glm::dot(plane, glm::vec4(min.x, max.y, max.z, 1)),
-            glm::dot(plane, glm::vec4(max.x, max.y, max.z, 1))
-        });
+        // Since the distance function is linear, it attains its maximum at the corner furthest
+        // along the plane normal (the p-vertex), which we can pick from the signs of the normal
+        auto p = glm::vec3(plane.x > 0 ? max.x : min.x, plane.y > 0 ? max.y : min.y, plane.z > 0 ? max.z : min.z);
+        return glm::dot(glm::vec3(plane), p) + plane.w;
     }
 
+    // Same as above, but the minimum, attained at the corner nearest along the normal (the n-vertex)
+    inline float planeMinDistanceAABB(const glm::vec4& plane, const glm::vec3& min, const glm::vec3& max)
+    {
+        auto n = glm::vec3(plane.x > 0 ? min.x : max.x, plane.y > 0 ? min.y : max.y, plane.z > 0 ? min.z : max.z);
+        return glm::dot(glm::vec3(plane), n) + plane.w;
+    }
+
+    enum class FrustumTest { Outside, Intersecting, Inside };
+
+    // A list of AABBs laid out as structure of arrays, so they can be tested many at a time
+    struct AABBList final
+    {
+        std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+        std::size_t size() const { return minX.size(); }
+
+        void push_back(const glm::vec3& min, const glm::vec3& max)
+        {
+            minX.push_back(min.x); minY.push_back(min.y); minZ.push_back(min.z);
+            maxX.push_back(max.x); maxY.push_back(max.y); maxZ.push_back(max.z);
+        }
+    };
+
     struct Frustum final
     {
-        glm::vec4 left, right, bottom, top, near, far;
+        std::array<glm::vec4, 6> planes; // left, right, bottom, top, near, far
 
-        bool checkIntersectionAABB(const glm::vec3& min, const glm::vec3& max)
+        bool checkIntersectionAABB(const glm::vec3& min, const glm::vec3& max) const
         {
             // Check for each plane if it has a positive distance
-            for (const auto& plane : { left, right, bottom, top, near, far })
+            for (const auto& plane : planes)
                 if (planeDistanceAABB(plane, min, max) <= 0) return false;
 
             return true;
         }
+
+        // Also tells whether the AABB is entirely inside, so its contents don't need to be tested
+        FrustumTest classifyAABB(const glm::vec3& min, const glm::vec3& max) const
+        {
+            auto result = FrustumTest::Inside;
+            for (const auto& plane : planes)
+            {
+                if (planeDistanceAABB(plane, min, max) <= 0) return FrustumTest::Outside;
+                if (planeMinDistanceAABB(plane, min, max) <= 0) result = FrustumTest::Intersecting;
+            }
+
+            return result;
+        }
+
+        // Writes 1 to visible[i] if the i-th AABB intersects the frustum, 0 otherwise
+        void checkIntersectionAABBsScalar(const AABBList& boxes, std::uint8_t* visible) const
+        {
+            checkIntersectionAABBsScalar(boxes, visible, 0);
+        }
+
+        void checkIntersectionAABBs(const AABBList& boxes, std::uint8_t* visible) const
+        {
+#ifdef FRUSTUM_SIMD
+            checkIntersectionAABBsScalar(boxes, visible, checkIntersectionAABBsSIMD(boxes, visible));
+#else
+            checkIntersectionAABBsScalar(boxes, visible, 0);
+#endif
+        }
+
+    private:
+        void checkIntersectionAABBsScalar(const AABBList& boxes, std::uint8_t* visible, std::size_t first) const
+        {
+            for (std::size_t i = first; i < boxes.size(); i++)
+            {
+                auto min = glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]);
+                auto max = glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]);
+                visible[i] = checkIntersectionAABB(min, max);
+            }
+        }
+
+#ifdef FRUSTUM_SIMD
+        // Tests as many boxes as the vector width allows, and returns where the scalar loop should take over.
+        // The planes are the same for every lane, so the p-vertex is chosen per plane instead of per box
+        std::size_t checkIntersectionAABBsSIMD(const AABBList& boxes, std::uint8_t* visible) const
+        {
+            std::size_t i = 0;
+#ifdef __AVX__
+            for (; i + 8 <= boxes.size(); i += 8)
+            {
+                auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (const auto& plane : planes)
+                {
+                    auto px = _mm256_loadu_ps((plane.x > 0 ? boxes.maxX : boxes.minX).data() + i);
+                    auto py = _mm256_loadu_ps((plane.y > 0 ? boxes.maxY : boxes.minY).data() + i);
+                    auto pz = _mm256_loadu_ps((plane.z > 0 ? boxes.maxZ : boxes.minZ).data() + i);
+
+                    // Same order of operations as the scalar path, so both give the same results
+                    auto distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), px), _mm256_mul_ps(_mm256_set1_ps(plane.y), py));
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), pz));
+                    distance = _mm256_add_ps(distance, _mm256_set1_ps(plane.w));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GT_OQ));
+                }
+
+                auto mask = _mm256_movemask_ps(inside);
+                for (int k = 0; k < 8; k++) visible[i + k] = (mask >> k) & 1;
+            }
+#endif
+            for (; i + 4 <= boxes.size(); i += 4)
+            {
+                auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (const auto& plane : planes)
+                {
+                    auto px = _mm_loadu_ps((plane.x > 0 ? boxes.maxX : boxes.minX).data() + i);
+                    auto py = _mm_loadu_ps((plane.y > 0 ? boxes.maxY : boxes.minY).data() + i);
+                    auto pz = _mm_loadu_ps((plane.z > 0 ? boxes.maxZ : boxes.minZ).data() + i);
+
+                    auto distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), px), _mm_mul_ps(_mm_set1_ps(plane.y), py));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), pz));
+                    distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+                    inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, _mm_setzero_ps()));
+                }
+
+                auto mask = _mm_movemask_ps(inside);
+                for (int k = 0; k < 4; k++) visible[i + k] = (mask >> k) & 1;
+            }
+
+            return i;
+        }
+#endif
     };
 
     // Returns the (vector) equations of the planes in homogeneous coordinates
@@ -41,11 +154,11 @@ namespace util
     {
         auto pvt = glm::transpose(viewProj);
 
-        return 
-        {
+        return
+        {{
             pvt[3] + pvt[0], pvt[3] - pvt[0],
             pvt[3] + pvt[1], pvt[3] - pvt[1],
             pvt[3] + pvt[2], pvt[3] - pvt[2]
-        };
+        }};
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace util
+{
+    // FNV-1a hash, constexpr so it can be computed from string literals at compile time
+    constexpr std::uint64_t stringHash(std::string_view str)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char c : str)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// We only need the surfaceless platform, so keep X11 from leaking its macros in
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace egl
+{
+	class Exception : public std::runtime_error
+	{
+	public:
+		Exception(const std::string& what) : runtime_error(what) {}
+	};
+
+	inline static void checkError(const char* what)
+	{
+		auto error = eglGetError();
+		if (error != EGL_SUCCESS)
+			throw Exception(std::string(what) + " (EGL error " + std::to_string(error) + ")");
+	}
+
+	inline static auto getProcAddress(const char* name) { return eglGetProcAddress(name); }
+
+	// An OpenGL context which is not tied to any window, used for offscreen rendering
+	class HeadlessContext final
+	{
+		EGLDisplay display;
+		EGLContext context;
+
+		static EGLDisplay getSurfacelessDisplay()
+		{
+			// Mesa's surfaceless platform does not need a display server, so it works with llvmpipe on CI machines
+			auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+				eglGetProcAddress("eglGetPlatformDisplayEXT"));
+			if (getPlatformDisplay)
+			{
+				auto display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+				if (display != EGL_NO_DISPLAY) return display;
+			}
+
+			// Fall back to whatever the default display is
+			return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+
+	public:
+		HeadlessContext() noexcept : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT) {}
+
+		HeadlessContext(int major, int minor, bool debug = false) : HeadlessContext()
+		{
+			display = getSurfacelessDisplay();
+			if (display == EGL_NO_DISPLAY) throw Exception("No EGL display available!");
+
+			if (!eglInitialize(display, nullptr, nullptr)) checkError("Failed to initialize EGL");
+			if (!eglBindAPI(EGL_OPENGL_API)) checkError("Failed to bind the OpenGL API");
+
+			const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+			EGLConfig config;
+			EGLint numConfigs;
+			if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+				throw Exception("No EGL config supports OpenGL!");
+
+			const EGLint contextAttribs[] =
+			{
+				EGL_CONTEXT_MAJOR_VERSION, major,
+				EGL_CONTEXT_MINOR_VERSION, minor,
+				EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+				EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+				EGL_NONE
+			};
+
+			context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+			if (context == EGL_NO_CONTEXT) checkError("Failed to create the OpenGL context");
+		}
+
+		// Disable copying, enable moving
+		HeadlessContext(const HeadlessContext&) = delete;
+		HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+		HeadlessContext(HeadlessContext&& other) noexcept : HeadlessContext() { *this = std::move(other); }
+		HeadlessContext& operator=(HeadlessContext&& other) noexcept
+		{
+			std::swap(display, other.display);
+			std::swap(context, other.context);
+			return *this;
+		}
+
+		// There is no surface: all drawing has to go to framebuffer objects
+		void makeCurrent() const
+		{
+			if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+				checkError("Failed to make the context current");
+		}
+
+		~HeadlessContext()
+		{
+			if (display == EGL_NO_DISPLAY) return;
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+			eglTerminate(display);
+		}
+	};
+}